@@ -2,16 +2,34 @@
 
 namespace actions {
 	actions_t str_map(const char* const str) {
-		if(strcmp(str, "request") == 0) {
-			return actions_t::REQUEST;
-		} else if(strcmp(str, "reply") == 0) {
-			return actions_t::REPLY;
-		} else if(strcmp(str, "wait") == 0) {
-			return actions_t::WAIT;
-		} else if(strcmp(str, "push") == 0) {
-			return actions_t::PUSH;
-		} else {
-			throw std::runtime_error(err_msg::_undhcse);
+		// Hashing picks the one action to compare against, and equal case labels fail
+		// to compile, so adding actions cannot introduce a collision
+		switch(str_hash(str)) {
+		 case ct_str_hash("request"):
+			if(strcmp(str, "request") == 0) {
+				return actions_t::REQUEST;
+			}
+			break;
+		
+		 case ct_str_hash("reply"):
+			if(strcmp(str, "reply") == 0) {
+				return actions_t::REPLY;
+			}
+			break;
+		
+		 case ct_str_hash("wait"):
+			if(strcmp(str, "wait") == 0) {
+				return actions_t::WAIT;
+			}
+			break;
+		
+		 case ct_str_hash("push"):
+			if(strcmp(str, "push") == 0) {
+				return actions_t::PUSH;
+			}
+			break;
 		}
+		
+		throw std::runtime_error(err_msg::_undhcse);
 	}
 }
\ No newline at end of file
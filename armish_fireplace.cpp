@@ -42,6 +42,9 @@ int main(int argc, char *argv[]) {
 		// trhough synchronous transmission.
 		std::string oEndpoint;
 		
+		// The parameter string to be passed to the server for configuration.
+		std::string serverParam;
+		
 		// This is the name of the module to which load processing units from. A module
 		// provides code common to processing units.
 		std::string moduleName;
@@ -63,6 +66,7 @@ int main(int argc, char *argv[]) {
 			("help,h",										"Print help")
 			("iendpoint,i",	B_PO_HELPER_REQ(iEndpoint),		"Input endpoint")
 			("oendpoint,o",	B_PO_HELPER_REQ(oEndpoint),		"Output endpoint")
+			("sparam,s",	B_PO_HELPER(serverParam),		"Server parameters")
 			("mname,m",		B_PO_HELPER_REQ(moduleName),	"Module name")
 			("mparam,n",	B_PO_HELPER(moduleParam),		"Module parameters")
 			("puname,t",	B_PO_HELPER_REQ(procUnitName),	"Processing unit name")
@@ -81,6 +85,7 @@ int main(int argc, char *argv[]) {
 		
 		// Set server endpoints
 		mwServer.setup(iEndpoint.c_str(), oEndpoint.c_str());
+		mwServer.string_initialize_parameters(serverParam.c_str());
 		
 		// Load module and processing unit
 		// The server responds to the change in state automatically
@@ -110,6 +115,8 @@ int main(int argc, char *argv[]) {
 	// Wait for signal
 	pause();
 	
+	mwServer.report(std::cerr);
+	
 	// We call destructors of the objects we've created above in the proper order per the
 	// standard, and these destructors shutdown everything gracefully.
 	return signalCode;
@@ -1,45 +1,191 @@
 #include "buffer_item.hpp"
+#include "slab_allocator.hpp"
 
 namespace buffer {
+	parameters::parameters(const char* const* const parameterList,
+			const std::size_t* const lengths,
+			const std::size_t count)
+			: _block(_inline), _size(0) {
+		if(count == 0) {
+			return;
+		}
+		
+		std::size_t blockSize = (count + 1) * sizeof(offset_t);
+		for(std::size_t i = 0; i < count; i++) {
+			blockSize += (lengths != 0 ? lengths[i] : strlen(parameterList[i])) + 1;
+		}
+		
+		allocate(blockSize, count);
+		
+		offset_t position = (count + 1) * sizeof(offset_t);
+		for(std::size_t i = 0; i < count; i++) {
+			const auto length = lengths != 0 ? lengths[i] : strlen(parameterList[i]);
+			
+			memcpy(_block + i * sizeof(offset_t), &position, sizeof(offset_t));
+			memcpy(_block + position, parameterList[i], length);
+			_block[position + length] = '\0';
+			position += length + 1;
+		}
+		memcpy(_block + count * sizeof(offset_t), &position, sizeof(offset_t));
+		
+		_size = count;
+	}
+	
+	parameters::parameters(const char* const*&& parameterList,
+			const std::size_t size,
+			bool isAllocated)
+			: parameters(parameterList, 0, parameterList != 0 ? size : 0) {
+		if(isAllocated && parameterList != 0) {
+			for(std::size_t i = 0; i < size; i++) {
+				delete[] parameterList[i];
+			}
+			delete[] parameterList;
+		}
+	}
+	
+	parameters::parameters(parameters&& item)
+			: _block(_inline), _size(0) {
+		*this = std::move(item);
+	}
+	
+	parameters& parameters::operator=(parameters&& item) {
+		if(this == &item) {
+			return *this;
+		}
+		
+		release();
+		
+		if(item._block == item._inline) {
+			// Inline blocks cannot be stolen, only copied
+			memcpy(_inline, item._inline, item.packed_size());
+		} else {
+			_block = item._block;
+			item._block = item._inline;
+		}
+		
+		_size = item._size;
+		item._size = 0;
+		
+		return *this;
+	}
+	
+	parameters::~parameters() {
+		release();
+	}
+	
+	parameters parameters::unpack(const char* const block,
+			const std::size_t blockSize,
+			const std::size_t count) {
+		parameters result;
+		
+		if(count != 0) {
+			result.allocate(blockSize, count);
+			memcpy(result._block, block, blockSize);
+			result._size = count;
+		}
+		
+		return result;
+	}
+	
+	void parameters::allocate(const std::size_t blockSize, const std::size_t count) {
+		if(blockSize > BUFFER_PARAMETERS_INLINE_SIZE ||
+				count > BUFFER_PARAMETERS_INLINE_COUNT) {
+			_block = new char[blockSize];
+		} else {
+			_block = _inline;
+		}
+	}
+	
+	void parameters::release() {
+		if(_block != _inline) {
+			delete[] _block;
+			_block = _inline;
+		}
+		
+		_size = 0;
+	}
+	
 	buffer_item::buffer_item(const char* const data,
 			const std::size_t size,
-			const char* const*&& parameterList,
-			const std::size_t count,
-			const bool isAllocated)
+			::buffer::parameters&& itemParameters)
 			: _size(size),
-			_parameters(std::move(parameterList), count, isAllocated) {
+			_parameters(std::move(itemParameters)),
+			_message(),
+			_isMessage(false) {
 		if(data != 0 && size != 0) {
-			_data = new char[_size];
+			_data = slab_allocator::allocate(_size);
 			memcpy(_data, data, _size);
 		} else {
 			_data = 0;
 		}
 	}
 	
+	buffer_item::buffer_item(const char* const data,
+			const std::size_t size,
+			const char* const*&& parameterList,
+			const std::size_t count,
+			const bool isAllocated)
+			: buffer_item(data,
+				size,
+				::buffer::parameters(std::move(parameterList), count, isAllocated)) {
+	}
+	
+	buffer_item::buffer_item(::zmq::message_t&& message,
+			::buffer::parameters&& itemParameters)
+			: _data(0),
+			_size(message.size()),
+			_parameters(std::move(itemParameters)),
+			_message(std::move(message)),
+			_isMessage(true) {
+	}
+	
+	buffer_item::buffer_item(::zmq::message_t&& message,
+			const char* const*&& parameterList,
+			const std::size_t count,
+			const bool isAllocated)
+			: buffer_item(std::move(message),
+				::buffer::parameters(std::move(parameterList), count, isAllocated)) {
+	}
+	
 	buffer_item::buffer_item(buffer_item&& item)
-			: _parameters(std::move(item._parameters)) {
+			: _parameters(std::move(item._parameters)),
+			_message(std::move(item._message)),
+			_isMessage(item._isMessage) {
 		_data = item._data;
 		item._data = 0;
 		_size = item._size;
 		item._size = 0;
+		item._isMessage = false;
 	}
 	
 	buffer_item& buffer_item::operator=(buffer_item&& item) {
+		if(this == &item) {
+			return *this;
+		}
+		
+		slab_allocator::deallocate(_data);
 		_data = item._data;
 		item._data = 0;
 		_size = item._size;
 		item._size = 0;
 		_parameters = std::move(item._parameters);
+		_message = std::move(item._message);
+		_isMessage = item._isMessage;
+		item._isMessage = false;
 		return *this;
 	}
 	
 	buffer_item::~buffer_item() {
-		if(_data != 0) {
-			delete[] _data;
-		}
+		slab_allocator::deallocate(_data);
 	}
 	
 	const char* buffer_item::data() const {
+		// Small messages keep their data inline, so the pointer is not stable across
+		// moves and must be looked up each time
+		if(_isMessage) {
+			return static_cast<const char*>(_message.data());
+		}
+		
 		return _data;
 	}
 	
@@ -47,6 +193,16 @@ namespace buffer {
 		return _size;
 	}
 	
+	char* buffer_item::release_data() {
+		assert(!_isMessage);
+		
+		auto result = _data;
+		_data = 0;
+		_size = 0;
+		
+		return result;
+	}
+	
 	const parameters& buffer_item::parameters() const {
 		return _parameters;
 	}
@@ -2,20 +2,67 @@
 #define _BUFFER_BUFFER_ITEM_HPP
 
 #include <common.hpp>
+#include <cppzmq/zmq.hpp>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * \brief The bytes of inline storage for flattened parameters.
+ * 
+ * Sized for a handful of short routing parameters, such as an address and a port.
+ */
+#define BUFFER_PARAMETERS_INLINE_SIZE 64
+
+/**
+ * \brief The most parameters held inline.
+ */
+#define BUFFER_PARAMETERS_INLINE_COUNT 4
 
 namespace buffer {
 		/**
 		 * \brief An array of parameters.
+		 * 
+		 * The parameters are flattened into a single block holding a table of offsets
+		 * followed by the bytes of every parameter, each terminated by a null character.
+		 * Blocks of up to BUFFER_PARAMETERS_INLINE_COUNT parameters that fit within
+		 * BUFFER_PARAMETERS_INLINE_SIZE bytes are held inline without any allocation,
+		 * and anything larger takes a single allocation.
+		 * 
+		 * Parameters carry their length, so they may hold binary data such as a packed
+		 * address.
 		 */
 		struct parameters {
+		 private:
+			/**
+			 * \brief The type of an entry in the offset table.
+			 */
+			using offset_t = std::uint32_t;
+		
 		 public:
 			/**
-			 * \brief Constructor.
+			 * \brief Constructor of an empty array.
 			 */
-			parameters(const char* const*&& parameterList, const std::size_t size, bool isAllocated = false)
-					: _parameters(parameterList), _size(size), _isAllocated(isAllocated) {
+			parameters()
+					: _block(_inline), _size(0) {
 			}
 			
+			/**
+			 * \brief Constructor copies count parameters into the block.
+			 * 
+			 * If lengths is NULL each parameter is taken to be a null terminated string.
+			 */
+			parameters(const char* const* const parameterList,
+					const std::size_t* const lengths,
+					const std::size_t count);
+			
+			/**
+			 * \brief Constructor copies an array of null terminated strings.
+			 * 
+			 * If isAllocated is set the array and each string were allocated with new[],
+			 * and are deleted once copied.
+			 */
+			parameters(const char* const*&& parameterList, const std::size_t size, bool isAllocated = false);
+			
 			/**
 			 * \brief Copy constructor is disabled.
 			 */
@@ -24,14 +71,7 @@ namespace buffer {
 			/**
 			 * \brief Move constructor.
 			 */
-			parameters(parameters&& item) {
-				_parameters = item._parameters;
-				item._parameters = 0;
-				_size = item._size;
-				item._size = 0;
-				_isAllocated = item._isAllocated;
-				item._isAllocated = false;
-			}
+			parameters(parameters&& item);
 			
 			/**
 			 * \brief Assignment operator is disabled.
@@ -41,59 +81,103 @@ namespace buffer {
 			/**
 			 * \brief Move assignment operator.
 			 */
-			parameters& operator=(parameters&& item) {
-				_parameters = item._parameters;
-				item._parameters = 0;
-				_size = item._size;
-				item._size = 0;
-				_isAllocated = item._isAllocated;
-				item._isAllocated = false;
-				return *this;
-			}
+			parameters& operator=(parameters&& item);
 			
 			/**
 			 * \brief Destructor.
 			 */
-			~parameters() {
-				if(_isAllocated && _parameters != 0) {
-					for(std::size_t i = 0; i < _size; i++) {
-						delete[] _parameters[i];
-					}
-					delete[] _parameters;
-				}
-			}
+			~parameters();
 			
 			/**
-			 * \brief Return a parameter string by index.
+			 * \brief Return a parameter by index.
+			 * 
+			 * The parameter is always followed by a null character.
 			 */
 			inline const char* operator[](const std::size_t index) const {
 				assert(index < _size);
 				
-				return _parameters[index];
+				return _block + offset(index);
 			}
 			
 			/**
-			 * \brief Return the number of parameter strings.
+			 * \brief Return the length of a parameter by index.
+			 */
+			inline std::size_t length(const std::size_t index) const {
+				assert(index < _size);
+				
+				return offset(index + 1) - offset(index) - 1;
+			}
+			
+			/**
+			 * \brief Return the number of parameters.
 			 */
 			inline std::size_t size() const {
 				return _size;
 			}
 			
+			/**
+			 * \brief Return the flattened block, which may be stored and restored with
+			 * unpack().
+			 */
+			inline const char* packed() const {
+				return _block;
+			}
+			
+			/**
+			 * \brief Return the size of the flattened block.
+			 * 
+			 * \note Bytes.
+			 */
+			inline std::size_t packed_size() const {
+				return _size == 0 ? 0 : offset(_size);
+			}
+			
+			/**
+			 * \brief Restore an array of count parameters from a block returned by
+			 * packed().
+			 */
+			static parameters unpack(const char* const block,
+					const std::size_t blockSize,
+					const std::size_t count);
+			
 		 private:
 			/**
-			 * \brief \todo
+			 * \brief The block, pointing at _inline or a heap allocation.
 			 */
-			const char* const* _parameters;
+			char* _block;
 		
 			/**
-			 * \brief \todo
+			 * \brief The number of parameters.
 			 */
 			std::size_t _size;
 			
 			/**
-			 * \brief \todo
+			 * \brief Inline storage for small blocks.
+			 */
+			char _inline[BUFFER_PARAMETERS_INLINE_SIZE];
+			
+			/**
+			 * \brief Return an entry of the offset table.
+			 * 
+			 * The table may be unaligned within the block, so it is read by copy.
+			 */
+			inline std::size_t offset(const std::size_t index) const {
+				offset_t result;
+				memcpy(&result, _block + index * sizeof(offset_t), sizeof(offset_t));
+				
+				return result;
+			}
+			
+			/**
+			 * \brief Point the block at inline storage or a new allocation that fits
+			 * blockSize bytes of count parameters.
+			 */
+			void allocate(const std::size_t blockSize, const std::size_t count);
+			
+			/**
+			 * \brief Give back a heap block, if any, and leave the array empty.
 			 */
-			bool _isAllocated;
+			void release();
 		};
 	
 	/**
@@ -103,6 +187,17 @@ namespace buffer {
 	 public:
 		/**
 		 * \brief Default initialization constructor.
+		 * 
+		 * The data is copied into a payload drawn from the slab allocator.
+		 */
+		buffer_item(const char* const data,
+				const std::size_t size,
+				::buffer::parameters&& itemParameters = ::buffer::parameters());
+		
+		/**
+		 * \brief Initialization constructor from an array of null terminated strings.
+		 * 
+		 * The strings are flattened into the item parameters, see parameters.
 		 */
 		buffer_item(const char* const data,
 				const std::size_t size,
@@ -110,6 +205,23 @@ namespace buffer {
 				const std::size_t count,
 				const bool isAllocated);
 		
+		/**
+		 * \brief Adopting constructor takes ownership of a received zmq message.
+		 * 
+		 * The message data is not copied; the item refers to it until the item is
+		 * destroyed or the message is sent on with message().
+		 */
+		buffer_item(::zmq::message_t&& message,
+				::buffer::parameters&& itemParameters = ::buffer::parameters());
+		
+		/**
+		 * \brief Adopting constructor from an array of null terminated strings.
+		 */
+		buffer_item(::zmq::message_t&& message,
+				const char* const*&& parameterList,
+				const std::size_t count,
+				const bool isAllocated);
+		
 		/**
 		 * \brief Copy constructor is disabled.
 		 */
@@ -133,7 +245,8 @@ namespace buffer {
 		/**
 		 * \brief Destructor.
 		 * 
-		 * Deletes the allocated memory for data.
+		 * Gives the data back to the slab allocator, on whichever thread the item is
+		 * destroyed.
 		 */
 		~buffer_item();
 		
@@ -147,10 +260,42 @@ namespace buffer {
 		 */
 		std::size_t size() const;
 		
+		/**
+		 * \brief Give up ownership of the data and return it.
+		 * 
+		 * The caller becomes responsible for giving the data back with
+		 * slab_allocator::deallocate(), which lets the data outlive the item, such as
+		 * until zmq has sent it. The item is left empty.
+		 * 
+		 * \warning Only valid when is_message() is false.
+		 */
+		char* release_data();
+		
 		/**
 		 * \brief Return a reference to the item parameters.
 		 */
 		const ::buffer::parameters& parameters() const;
+		
+		/**
+		 * \brief Return whether or not the item holds an adopted zmq message.
+		 */
+		inline bool is_message() const {
+			return _isMessage;
+		}
+		
+		/**
+		 * \brief Return the adopted zmq message so it may be sent as is.
+		 * 
+		 * Sending the message empties it, after which data() and size() of the item
+		 * are no longer meaningful.
+		 * 
+		 * \warning Only valid when is_message() is true.
+		 */
+		inline ::zmq::message_t& message() {
+			assert(_isMessage);
+			
+			return _message;
+		}
 	
 	 private:
 		/**
@@ -167,6 +312,16 @@ namespace buffer {
 		 * \brief \todo
 		 */
 		::buffer::parameters _parameters;
+		
+		/**
+		 * \brief The adopted message when constructed from one, otherwise empty.
+		 */
+		::zmq::message_t _message;
+		
+		/**
+		 * \brief Whether or not the data lives in _message rather than _data.
+		 */
+		bool _isMessage;
 	};
 }
 
@@ -0,0 +1,9 @@
+#include "istore.hpp"
+
+namespace buffer {
+	istore::istore() {
+	}
+	
+	istore::~istore() {
+	}
+}
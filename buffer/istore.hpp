@@ -0,0 +1,88 @@
+#ifndef _BUFFER_ISTORE_HPP
+#define _BUFFER_ISTORE_HPP
+
+#include <common.hpp>
+#include "buffer_item.hpp"
+#include <vector>
+
+namespace buffer {
+	/**
+	 * \brief The interface definition for the storage behind a queue_buffer.
+	 * 
+	 * A store is a FIFO that may be pushed into by any number of producer threads and
+	 * is drained by a single consumer thread. Accounting, signaling, and policy are left
+	 * to the queue_buffer that owns the store.
+	 */
+	class istore {
+	 public:
+		/**
+		 * \brief Constructor.
+		 */
+		istore();
+		
+		/**
+		 * \brief Copy constructor is disabled.
+		 */
+		istore(const istore&) = delete;
+		
+		/**
+		 * \brief Move constructor is disabled.
+		 */
+		istore(istore&&) = delete;
+		
+		/**
+		 * \brief Assignment operator is disabled.
+		 */
+		istore& operator=(const istore&) = delete;
+		
+		/**
+		 * \brief Move assignment operator is disabled.
+		 */
+		istore& operator=(istore&&) = delete;
+		
+		/**
+		 * \brief Virtual destructor.
+		 */
+		virtual ~istore();
+		
+		/**
+		 * \brief Try to push an item into the store.
+		 * 
+		 * If the store has no room for the item we return false and the item is left
+		 * untouched.
+		 * 
+		 * \warning The implementation of this function must be threadsafe for multiple
+		 * producers.
+		 */
+		virtual bool push(buffer_item&& item) = 0;
+		
+		/**
+		 * \brief Move the oldest items within the store onto the back of out, in order.
+		 * 
+		 * At most maxItems are moved, or every item if maxItems is zero.
+		 * 
+		 * \warning The implementation of this function must be threadsafe with respect
+		 * to producers, but only a single consumer may call it at a time.
+		 * 
+		 * \returns The total size of the data of the moved items.
+		 */
+		virtual std::size_t pop(std::vector<buffer_item>& out,
+				const std::size_t maxItems) = 0;
+		
+		/**
+		 * \brief Discard the oldest item within the store.
+		 * 
+		 * Called by producers to make room under a drop oldest overflow policy. If the
+		 * store is empty, or does not support removal by producers, we return false.
+		 * 
+		 * \warning The implementation of this function must be threadsafe with respect
+		 * to producers and the consumer.
+		 * 
+		 * \returns Whether or not an item was discarded, with the size of its data
+		 * written to itemBytes.
+		 */
+		virtual bool drop_front(std::size_t& itemBytes) = 0;
+	};
+}
+
+#endif
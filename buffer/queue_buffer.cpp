@@ -1,55 +1,510 @@
 #include "queue_buffer.hpp"
+#include "store/locked_store.hpp"
+#include "store/ring_store.hpp"
+#include "store/sharded_store.hpp"
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 namespace buffer {
 	queue_buffer::queue_buffer()
-				: pushWaitEnabled(false),
-				pushWaitNew(0),
-				pushWaitThreshold(0) {
+			: queue_buffer(config()) {
+	}
+	
+	queue_buffer::queue_buffer(const config& configuration)
+			: laneCount(checked_lanes(configuration)),
+			lanes(new lane[laneCount]),
+			starvationLimit(configuration.starvationLimit),
+			starvedDrains(0),
+			maxItems(configuration.maxItems),
+			maxBytes(configuration.maxBytes),
+			overflow(configuration.overflow),
+			count(0),
+			byteCount(0),
+			highWaterItems(0),
+			highWaterBytes(0),
+			droppedItems(0),
+			blockedPushes(0),
+			blockedProducers(0),
+			releases(0),
+			interrupted(false),
+			spilling(false),
+			journalCount(0),
+			spilledItems(0),
+			urgentPending(false),
+			pushWaitEnabled(false),
+			pushWaitNew(0),
+			pushWaitThreshold(0),
+			pushWaitSignaled(false),
+			pushEvent(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+			pushEventArmed(false) {
+		if(UNLIKELY(pushEvent < 0)) {
+			throw std::runtime_error(err_msg::_fdunavl);
+		}
+		
+		for(std::size_t i = 0; i < laneCount; i++) {
+			lanes[i].store.reset(make_store(configuration));
 		}
+		
+		if(overflow == overflow_policy::spill) {
+			if(UNLIKELY(configuration.spillDirectory.empty())) {
+				throw std::invalid_argument(err_msg::_unsprtd);
+			}
+			
+			journal.reset(new spill_journal(configuration.spillDirectory,
+					configuration.spillSegmentSize));
+		}
+	}
+	
+	queue_buffer::~queue_buffer() {
+		close(pushEvent);
+	}
 	
 	void queue_buffer::set_push_wait_threshold(const std::size_t threshold) {
-		lock_t lock(queueMutex);
+		lock_t lock(waitMutex);
 		
-		pushWaitEnabled = true;
 		pushWaitThreshold = threshold;
+		pushWaitEnabled = true;
+		
+		// Count towards the new threshold from here
+		reset_push_wait();
 	}
 	
 	std::size_t queue_buffer::size() {
-		lock_t lock(queueMutex);
+		return count.load(std::memory_order_relaxed) +
+				journalCount.load(std::memory_order_relaxed);
+	}
+	
+	std::size_t queue_buffer::bytes() {
+		return byteCount.load(std::memory_order_relaxed);
+	}
+	
+	queue_buffer::stats queue_buffer::statistics() {
+		stats result;
+		result.highWaterItems = highWaterItems.load(std::memory_order_relaxed);
+		result.highWaterBytes = highWaterBytes.load(std::memory_order_relaxed);
+		result.droppedItems = droppedItems.load(std::memory_order_relaxed);
+		result.blockedPushes = blockedPushes.load(std::memory_order_relaxed);
+		result.spilledItems = spilledItems.load(std::memory_order_relaxed);
+		result.spillBacklog = journalCount.load(std::memory_order_relaxed);
 		
-		return queue.size();
+		return result;
 	}
 	
-	void queue_buffer::push(buffer_item&& item) {
-		lock_t lock(queueMutex);
+	bool queue_buffer::push(buffer_item&& item, const std::size_t priority) {
+		// Items follow those already spilled so they stay in order
+		if(UNLIKELY(spilling.load(std::memory_order_relaxed))) {
+			switch(spill(item, false)) {
+			 case spill_result::spilled:
+				signal_push(priority);
+				return true;
+			
+			 case spill_result::failed:
+				// Storing it in memory would send it ahead of older spilled items
+				droppedItems.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			
+			 case spill_result::not_spilling:
+				break;
+			}
+		}
+		
+		// Account before the item is visible so a racing pop cannot underflow
+		if(UNLIKELY(!reserve(item.size()))) {
+			if(overflow == overflow_policy::spill &&
+					spill(item, true) == spill_result::spilled) {
+				signal_push(priority);
+				return true;
+			}
+			
+			droppedItems.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
 		
-		queue.push(std::move(item));
+		auto& target = lanes[priority < laneCount ? priority : laneCount - 1];
+		target.count.fetch_add(1, std::memory_order_relaxed);
 		
-		if(pushWaitEnabled && ++pushWaitNew >= pushWaitThreshold) {
-			pushWaitCV.notify_all();
+		if(UNLIKELY(!store_item(target, item))) {
+			// A full store is an implicit limit, so take the accounting back
+			target.count.fetch_sub(1, std::memory_order_relaxed);
+			release(1, item.size());
+			
+			if(overflow == overflow_policy::spill &&
+					spill(item, true) == spill_result::spilled) {
+				signal_push(priority);
+				return true;
+			}
+			
+			droppedItems.fetch_add(1, std::memory_order_relaxed);
+			return false;
 		}
+		
+		signal_push(priority);
+		
+		return true;
+	}
+	
+	void queue_buffer::interrupt() {
+		lock_t lock(spaceMutex);
+		
+		interrupted = true;
+		spaceCV.notify_all();
+	}
+	
+	void queue_buffer::resume() {
+		lock_t lock(spaceMutex);
+		
+		interrupted = false;
 	}
 	
 	std::queue<buffer_item> queue_buffer::pop_all() {
-		lock_t lock(queueMutex);
+		std::vector<buffer_item> items;
+		pop_into(items);
 		
 		std::queue<buffer_item> returnQueue;
-		std::swap(queue, returnQueue);
+		for(auto& item : items) {
+			returnQueue.push(std::move(item));
+		}
 		
 		return returnQueue;
 	}
 	
-	bool queue_buffer::push_wait(const std::size_t milliseconds) {			
-		lock_t lock(queueMutex);
+	std::size_t queue_buffer::pop_into(std::vector<buffer_item>& out,
+			const std::size_t maxItems) {
+		const auto before = out.size();
+		std::size_t itemBytes = 0;
 		
-		if(queue.size() >= pushWaitThreshold ||
+		if(LIKELY(laneCount == 1)) {
+			itemBytes = pop_lane(0, out, maxItems, before);
+		} else if(UNLIKELY(starvationLimit != 0 && starvedDrains >= starvationLimit)) {
+			// Give the lower lanes a turn at the front of the drain
+			starvedDrains = 0;
+			for(std::size_t i = 0; i < laneCount; i++) {
+				itemBytes += pop_lane(i, out, maxItems, before);
+			}
+		} else {
+			// Only a drain that fills up stops short of the lower lanes
+			std::size_t lowestServed = 0;
+			for(std::size_t i = laneCount; i-- > 0;) {
+				itemBytes += pop_lane(i, out, maxItems, before);
+				if(maxItems != 0 && out.size() - before == maxItems) {
+					lowestServed = i;
+					break;
+				}
+			}
+			
+			bool starved = false;
+			for(std::size_t i = 0; i < lowestServed; i++) {
+				if(lanes[i].count.load(std::memory_order_relaxed) != 0) {
+					starved = true;
+					break;
+				}
+			}
+			
+			starvedDrains = starved ? starvedDrains + 1 : 0;
+		}
+		
+		const auto itemCount = out.size() - before;
+		
+		if(itemCount != 0) {
+			release(itemCount, itemBytes);
+		}
+		
+		// Whatever was pushed before the drain no longer counts towards a batch
+		reset_push_wait();
+		
+		// Spilled items are newer than anything in memory, including items still on
+		// their way into a store, so they wait until memory is empty
+		if(UNLIKELY(spilling.load(std::memory_order_relaxed)) &&
+				count.load() == 0 &&
+				(maxItems == 0 || itemCount < maxItems)) {
+			return itemCount + replay(out, maxItems == 0 ? 0 : maxItems - itemCount);
+		}
+		
+		return itemCount;
+	}
+	
+	bool queue_buffer::push_wait(const std::size_t milliseconds) {
+		lock_t lock(waitMutex);
+		
+		if(size() >= pushWaitThreshold || urgentPending ||
 				pushCV.wait_for(lock, std::chrono::milliseconds(milliseconds), [this] {
-					return pushWaitNew >= pushWaitThreshold;
+					return pushWaitNew >= pushWaitThreshold || urgentPending;
 				})) {
-			pushWaitNew = 0;
+			reset_push_wait();
+			urgentPending = false;
 			return true;
 		}
 		
 		return false;
 	}
+	
+	bool queue_buffer::arm_push_event() {
+		// Sequentially consistent with the counts a producer raises before it checks
+		// the flag, so either we see the item or the producer sees the flag
+		pushEventArmed.store(true);
+		
+		if(count.load() != 0 || journalCount.load() != 0) {
+			pushEventArmed.store(false);
+			return false;
+		}
+		
+		return true;
+	}
+	
+	void queue_buffer::clear_push_event() {
+		std::uint64_t signals;
+		const auto result = read(pushEvent, &signals, sizeof(signals));
+		UNUSED(result);
+		
+		lock_t lock(waitMutex);
+		
+		reset_push_wait();
+		urgentPending = false;
+	}
+	
+	istore* queue_buffer::make_store(const config& configuration) {
+		if(configuration.overflow == overflow_policy::drop_oldest &&
+				configuration.store != store_type::locked) {
+			throw std::invalid_argument(err_msg::_unsprtd);
+		}
+		
+		switch(configuration.store) {
+		 case store_type::locked:
+			return new ::buffer::store::locked_store();
+		
+		 case store_type::ring:
+			return new ::buffer::store::ring_store(configuration.capacity);
+		
+		 case store_type::sharded:
+			return new ::buffer::store::sharded_store(configuration.shards,
+					configuration.capacity,
+					configuration.shardOrder == shard_order::sequenced);
+		}
+		
+		throw std::invalid_argument(err_msg::_undhcse);
+	}
+	
+	std::size_t queue_buffer::checked_lanes(const config& configuration) {
+		if(UNLIKELY(configuration.lanes == 0 ||
+				configuration.lanes > BUFFER_MAX_LANES)) {
+			throw std::invalid_argument(err_msg::_arybnds);
+		}
+		
+		return configuration.lanes;
+	}
+	
+	std::size_t queue_buffer::pop_lane(const std::size_t index,
+			std::vector<buffer_item>& out,
+			const std::size_t maxItems,
+			const std::size_t before) {
+		std::size_t remaining = 0;
+		if(maxItems != 0) {
+			remaining = maxItems - (out.size() - before);
+			if(remaining == 0) {
+				return 0;
+			}
+		}
+		
+		auto& source = lanes[index];
+		const auto start = out.size();
+		const auto result = source.store->pop(out, remaining);
+		
+		source.count.fetch_sub(out.size() - start, std::memory_order_relaxed);
+		
+		return result;
+	}
+	
+	bool queue_buffer::reserve(const std::size_t itemBytes) {
+		if(UNLIKELY(maxBytes != 0 && itemBytes > maxBytes)) {
+			// Would never fit, so no policy can make room for it
+			return false;
+		}
+		
+		bool waited = false;
+		
+		for(;;) {
+			const auto newCount = count.fetch_add(1) + 1;
+			const auto newBytes = byteCount.fetch_add(itemBytes) + itemBytes;
+			
+			if(LIKELY(has_room(newCount, newBytes))) {
+				raise_high_water(highWaterItems, newCount);
+				raise_high_water(highWaterBytes, newBytes);
+				return true;
+			}
+			
+			// Over a limit, back out and apply the policy
+			count.fetch_sub(1);
+			byteCount.fetch_sub(itemBytes);
+			
+			switch(overflow) {
+			 case overflow_policy::drop_newest:
+			 case overflow_policy::spill:
+				return false;
+			
+			 case overflow_policy::drop_oldest:
+				{
+					std::size_t droppedBytes;
+					std::size_t i = 0;
+					while(i < laneCount && !lanes[i].store->drop_front(droppedBytes)) {
+						i++;
+					}
+					
+					if(i == laneCount) {
+						// Everything accounted for is still on its way into a store
+						return false;
+					}
+					
+					lanes[i].count.fetch_sub(1, std::memory_order_relaxed);
+					
+					droppedItems.fetch_add(1, std::memory_order_relaxed);
+					release(1, droppedBytes);
+				}
+				break;
+			
+			 case overflow_policy::block:
+				{
+					if(!waited) {
+						waited = true;
+						blockedPushes.fetch_add(1, std::memory_order_relaxed);
+					}
+					
+					blockedProducers.fetch_add(1);
+					lock_t lock(spaceMutex);
+					spaceCV.wait(lock, [this, itemBytes] {
+						return interrupted ||
+								has_room(count + 1, byteCount + itemBytes);
+					});
+					blockedProducers.fetch_sub(1);
+					
+					if(interrupted) {
+						return false;
+					}
+				}
+				break;
+			}
+		}
+	}
+	
+	bool queue_buffer::store_item(lane& target, buffer_item& item) {
+		if(LIKELY(target.store->push(std::move(item)))) {
+			return true;
+		}
+		
+		// Only a bounded store refuses an item, and only blocking waits for room
+		if(overflow != overflow_policy::block) {
+			return false;
+		}
+		
+		blockedPushes.fetch_add(1, std::memory_order_relaxed);
+		blockedProducers.fetch_add(1);
+		
+		bool stored = false;
+		while(!interrupted) {
+			// Read before retrying so a release between the retry and the wait is seen
+			const auto seen = releases.load();
+			
+			if(target.store->push(std::move(item))) {
+				stored = true;
+				break;
+			}
+			
+			lock_t lock(spaceMutex);
+			spaceCV.wait(lock, [this, seen] {
+				return interrupted || releases.load() != seen;
+			});
+		}
+		
+		blockedProducers.fetch_sub(1);
+		
+		return stored;
+	}
+	
+	void queue_buffer::release(const std::size_t itemCount,
+			const std::size_t itemBytes) {
+		count.fetch_sub(itemCount);
+		byteCount.fetch_sub(itemBytes);
+		releases.fetch_add(1);
+		
+		// Sequentially consistent with the producer side so a waiter is never missed
+		if(blockedProducers.load() != 0) {
+			lock_t lock(spaceMutex);
+			spaceCV.notify_all();
+		}
+	}
+	
+	void queue_buffer::signal_push(const std::size_t priority) {
+		if(UNLIKELY(pushEventArmed.load()) && pushEventArmed.exchange(false)) {
+			// The consumer is asleep on an empty queue
+			signal_push_event();
+		}
+		
+		if(UNLIKELY(priority != 0 && laneCount > 1)) {
+			// Priority items do not wait for a batch to fill
+			lock_t lock(waitMutex);
+			urgentPending = true;
+			pushCV.notify_all();
+			signal_push_event();
+		} else if(pushWaitEnabled.load(std::memory_order_relaxed) &&
+				pushWaitNew.fetch_add(1) + 1 >= pushWaitThreshold &&
+				!pushWaitSignaled.load(std::memory_order_relaxed) &&
+				!pushWaitSignaled.exchange(true)) {
+			// Only the first push at or over the threshold takes the mutex
+			lock_t lock(waitMutex);
+			pushCV.notify_all();
+			signal_push_event();
+		}
+	}
+	
+	void queue_buffer::signal_push_event() {
+		const std::uint64_t signal = 1;
+		const auto result = write(pushEvent, &signal, sizeof(signal));
+		UNUSED(result);
+	}
+	
+	queue_buffer::spill_result queue_buffer::spill(const buffer_item& item,
+			const bool force) {
+		lock_t lock(spillMutex);
+		
+		if(!force && !spilling) {
+			// The consumer emptied the journal since we looked
+			return spill_result::not_spilling;
+		}
+		
+		if(UNLIKELY(!journal->append(item))) {
+			return spill_result::failed;
+		}
+		
+		spilling = true;
+		// Sequentially consistent for arm_push_event()
+		journalCount.fetch_add(1);
+		spilledItems.fetch_add(1, std::memory_order_relaxed);
+		
+		return spill_result::spilled;
+	}
+	
+	std::size_t queue_buffer::replay(std::vector<buffer_item>& out,
+			const std::size_t maxItems) {
+		lock_t lock(spillMutex);
+		
+		std::size_t result = 0;
+		while((maxItems == 0 || result < maxItems) && journal->read(out)) {
+			result++;
+		}
+		
+		journalCount.fetch_sub(result, std::memory_order_relaxed);
+		
+		if(journal->empty()) {
+			spilling = false;
+		}
+		
+		return result;
+	}
+	
+	void queue_buffer::raise_high_water(std::atomic<std::size_t>& mark,
+			const std::size_t value) {
+		auto current = mark.load(std::memory_order_relaxed);
+		while(current < value &&
+				!mark.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+		}
+	}
 }
@@ -3,14 +3,33 @@
 
 #include <common.hpp>
 #include "buffer_item.hpp"
+#include "istore.hpp"
+#include "spill_journal.hpp"
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
+#include <vector>
+
+/**
+ * \brief The most priority lanes a queue_buffer may be configured with.
+ */
+#define BUFFER_MAX_LANES 8
 
 namespace buffer {
 	/**
 	 * \brief A threadsafe FIFO buffer.
+	 * 
+	 * Items are held in a store, selected at construction, which determines how
+	 * producers are synchronized with the consumer.
+	 * 
+	 * The buffer may be split into priority lanes, each with a store of its own. The
+	 * consumer takes from higher lanes first, so items are only first in first out
+	 * within a lane. Limits and overflow policies apply to the buffer as a whole.
 	 */
 	class queue_buffer {
 	 private:
@@ -18,10 +37,218 @@ namespace buffer {
 	
 	 public:
 		/**
-		 * \brief Constructor.
+		 * \brief The stores an item may be held in.
+		 */
+		enum class store_type {
+			/**
+			 * \brief Unbounded queue protected by a mutex.
+			 */
+			locked,
+			
+			/**
+			 * \brief Bounded lock-free multi-producer/single-consumer ring.
+			 * 
+			 * A producer that finds the ring full applies the overflow policy, as if
+			 * it were at maxItems.
+			 */
+			ring,
+			
+			/**
+			 * \brief A bounded single-producer/single-consumer ring per producer thread.
+			 * 
+			 * Producers do not contend with each other. A producer that finds its ring
+			 * full applies the overflow policy, as if it were at maxItems.
+			 */
+			sharded
+		};
+		
+		/**
+		 * \brief The order the consumer takes items from a sharded store in.
+		 */
+		enum class shard_order {
+			/**
+			 * \brief Each shard in turn, so only items of one producer are in order.
+			 */
+			round_robin,
+			
+			/**
+			 * \brief Exactly the order items were pushed in across every producer, at
+			 * the cost of a shared counter.
+			 */
+			sequenced
+		};
+		
+		/**
+		 * \brief What a push does when the buffer is at its item or byte limit.
+		 */
+		enum class overflow_policy {
+			/**
+			 * \brief The producer waits until the consumer makes room.
+			 */
+			block,
+			
+			/**
+			 * \brief The oldest items are discarded to make room.
+			 * 
+			 * Not supported by the ring and sharded stores, whose producers cannot remove
+			 * items.
+			 */
+			drop_oldest,
+			
+			/**
+			 * \brief The pushed item is discarded.
+			 */
+			drop_newest,
+			
+			/**
+			 * \brief The pushed item is appended to a spill journal on disk.
+			 * 
+			 * Once anything is spilled every push goes to the journal until the consumer
+			 * has replayed all of it, which keeps items in order. Spilled items lose
+			 * their lane and are replayed after what is in memory. An item that cannot
+			 * be appended, being larger than a segment or for want of disk, is dropped
+			 * rather than sent ahead of them.
+			 */
+			spill
+		};
+		
+		/**
+		 * \brief Construction time configuration of the buffer.
+		 */
+		struct config {
+		 public:
+			/**
+			 * \brief Constructor sets the defaults, which match the historic behavior.
+			 */
+			config()
+					: store(store_type::locked),
+					capacity(4096),
+					shards(8),
+					shardOrder(shard_order::round_robin),
+					maxItems(0),
+					maxBytes(0),
+					overflow(overflow_policy::block),
+					lanes(1),
+					starvationLimit(8),
+					spillSegmentSize(64 * 1024 * 1024) {
+			}
+			
+			/**
+			 * \brief The store items are held in.
+			 */
+			store_type store;
+			
+			/**
+			 * \brief The number of slots of a ring store, or of each shard of a sharded
+			 * store.
+			 * 
+			 * Rounded up to the next power of two.
+			 */
+			std::size_t capacity;
+			
+			/**
+			 * \brief The number of shards of a sharded store.
+			 * 
+			 * Producer threads beyond this share an overflow queue.
+			 */
+			std::size_t shards;
+			
+			/**
+			 * \brief The order the consumer takes items from a sharded store in.
+			 */
+			shard_order shardOrder;
+			
+			/**
+			 * \brief The maximum number of items held, zero for no limit.
+			 */
+			std::size_t maxItems;
+			
+			/**
+			 * \brief The maximum number of data bytes held, zero for no limit.
+			 */
+			std::size_t maxBytes;
+			
+			/**
+			 * \brief What a push does when a limit would be exceeded.
+			 */
+			overflow_policy overflow;
+			
+			/**
+			 * \brief The number of priority lanes, at most BUFFER_MAX_LANES.
+			 * 
+			 * With a ring store each lane has a ring of capacity slots.
+			 */
+			std::size_t lanes;
+			
+			/**
+			 * \brief The number of consecutive limited drains that may leave a lower
+			 * lane untouched before a drain services the lowest lane first.
+			 */
+			std::size_t starvationLimit;
+			
+			/**
+			 * \brief The directory spill journal segments are created in.
+			 * 
+			 * Required by the spill overflow policy.
+			 */
+			std::string spillDirectory;
+			
+			/**
+			 * \brief The size of each spill journal segment.
+			 * 
+			 * \note Bytes.
+			 */
+			std::size_t spillSegmentSize;
+		};
+		
+		/**
+		 * \brief A snapshot of the buffer counters.
+		 */
+		struct stats {
+		 public:
+			/**
+			 * \brief The most items ever held at once.
+			 */
+			std::size_t highWaterItems;
+			
+			/**
+			 * \brief The most data bytes ever held at once.
+			 */
+			std::size_t highWaterBytes;
+			
+			/**
+			 * \brief Items discarded by an overflow policy.
+			 */
+			std::uint64_t droppedItems;
+			
+			/**
+			 * \brief Pushes that had to wait for room.
+			 */
+			std::uint64_t blockedPushes;
+			
+			/**
+			 * \brief Items written to the spill journal.
+			 */
+			std::uint64_t spilledItems;
+			
+			/**
+			 * \brief Items in the spill journal waiting to be replayed.
+			 */
+			std::size_t spillBacklog;
+		};
+		
+		/**
+		 * \brief Constructor with the default configuration.
 		 */
 		queue_buffer();
 		
+		/**
+		 * \brief Constructor with a supplied configuration.
+		 * 
+		 * \throws If the configuration is invalid we throw an invalid_argument.
+		 */
+		queue_buffer(const config& configuration);
+		
 		/**
 		 * \brief Copy constructor is disabled.
 		 * 
@@ -54,6 +281,11 @@ namespace buffer {
 		 */
 		queue_buffer& operator=(queue_buffer&&) = delete;
 		
+		/**
+		 * \brief Destructor.
+		 */
+		~queue_buffer();
+		
 		/**
 		 * \brief Set the threshold when a call to push_wait_for will be successful.
 		 * 
@@ -62,29 +294,93 @@ namespace buffer {
 		void set_push_wait_threshold(const std::size_t threshold);
 		
 		/**
-		 * \brief Return the number of items in the queue.
+		 * \brief Return the number of items in the queue, including any in the spill
+		 * journal.
 		 *
-		 * \note Threadsafe.
+		 * \note Threadsafe. With a lock-free store this is a snapshot that may be stale
+		 * by the time it is returned.
 		 */
 		std::size_t size();
 		
+		/**
+		 * \brief Return the number of data bytes held in memory by the queue.
+		 * 
+		 * \note Threadsafe, but a snapshot like size().
+		 */
+		std::size_t bytes();
+		
+		/**
+		 * \brief Return a snapshot of the buffer counters.
+		 * 
+		 * \note Threadsafe.
+		 */
+		stats statistics();
+		
 		/**
 		 * \brief Push an item into the queue.
+		 * 
+		 * The item goes into the lane of its priority, where higher numbers are taken
+		 * by the consumer first and lane zero is for bulk data. A priority beyond the
+		 * last lane goes into the last lane. Pushing above lane zero wakes a consumer
+		 * in push_wait() without waiting for the threshold.
+		 * 
+		 * If the buffer is at a limit the configured overflow policy is applied, which
+		 * may block the calling thread. Dropping the oldest takes from the lowest lane
+		 * first.
 		 *
 		 * \note Threadsafe.
+		 * 
+		 * \returns Whether or not the item was accepted. The item is discarded when
+		 * dropped by the overflow policy or when a blocked push is interrupted.
+		 */
+		bool push(buffer_item&& item, const std::size_t priority = 0);
+		
+		/**
+		 * \brief Wake any producer blocked in push() and make blocking pushes give up
+		 * until resume() is called.
+		 * 
+		 * Used when the consumer goes away so producers can be joined.
+		 * 
+		 * \note Threadsafe.
 		 */
-		void push(buffer_item&& item);
+		void interrupt();
+		
+		/**
+		 * \brief Let pushes block again after interrupt().
+		 * 
+		 * \note Threadsafe.
+		 */
+		void resume();
 		
 		/**
 		 * \brief Pop all the items current within the queue and return them in a queue of
 		 * their own.
 		 * 
 		 * Safe to call when the queue is empty, as it simply returns an empty queue.
+		 * 
+		 * Prefer pop_into() on hot paths, which does not build a new container per call.
 		 *
-		 * \note Threadsafe
+		 * \note Threadsafe, but there must only be one consumer.
 		 */
 		std::queue<buffer_item> pop_all();
 		
+		/**
+		 * \brief Pop up to maxItems of the oldest items within the queue onto the back of
+		 * a consumer owned vector, or every item if maxItems is zero.
+		 * 
+		 * Items are handed out by move, highest lane first and in order within a lane.
+		 * When limited drains keep filling up from higher lanes, every starvationLimit
+		 * drains one services the lowest lane first instead. A consumer that clears and
+		 * reuses the same vector across calls reaches a steady state without allocating.
+		 * 
+		 * Spilled items are replayed once nothing is left in memory.
+		 * 
+		 * \note Threadsafe, but there must only be one consumer.
+		 * 
+		 * \returns The number of items appended to out.
+		 */
+		std::size_t pop_into(std::vector<buffer_item>& out, const std::size_t maxItems = 0);
+		
 		/**
 		 * \brief Block up to a specified amount of time waiting for an item to be pushed
 		 * into the queue.
@@ -97,42 +393,364 @@ namespace buffer {
 		 * \returns Whether or not an item was pushed into the queue during our waiting.
 		 */
 		bool push_wait(const std::size_t milliseconds);
+		
+		/**
+		 * \brief Return a file descriptor that polls readable whenever push_wait()
+		 * would succeed, or after a push that follows arm_push_event().
+		 * 
+		 * This lets a consumer wait on the queue alongside sockets and other
+		 * descriptors in a single poll.
+		 * 
+		 * \note Threadsafe.
+		 */
+		inline int push_event() const {
+			return pushEvent;
+		}
+		
+		/**
+		 * \brief Make the next push signal the push event if the queue is empty.
+		 * 
+		 * Pushes do not otherwise signal it until the push wait threshold is reached,
+		 * so this lets a consumer that has drained the queue sleep until there is
+		 * something to take rather than waking periodically to check.
+		 * 
+		 * \note Threadsafe, but there must only be one consumer.
+		 * 
+		 * \returns Whether or not the queue was empty and the event was armed.
+		 */
+		bool arm_push_event();
+		
+		/**
+		 * \brief Reset the push event after it was signaled, as a successful
+		 * push_wait() does.
+		 * 
+		 * \note Threadsafe.
+		 */
+		void clear_push_event();
 	
 	 private:
 		/**
-		 * \brief \todo
+		 * \brief A priority lane.
+		 */
+		struct lane {
+		 public:
+			/**
+			 * \brief Constructor.
+			 */
+			lane()
+					: count(0) {
+			}
+			
+			/**
+			 * \brief The store holding the items of the lane.
+			 */
+			std::unique_ptr<istore> store;
+			
+			/**
+			 * \brief The number of items accounted to the lane.
+			 * 
+			 * Counted before the item is visible in the store, so only a hint.
+			 */
+			std::atomic<std::size_t> count;
+		};
+		
+		/**
+		 * \brief The outcome of appending an item to the journal.
+		 */
+		enum class spill_result {
+			/**
+			 * \brief The item was appended.
+			 */
+			spilled,
+			
+			/**
+			 * \brief Nothing is being spilled, so the item was not appended.
+			 */
+			not_spilling,
+			
+			/**
+			 * \brief The item is larger than a segment or a segment could not be
+			 * opened.
+			 */
+			failed
+		};
+		
+		/**
+		 * \brief The number of priority lanes.
+		 */
+		const std::size_t laneCount;
+		
+		/**
+		 * \brief The priority lanes, lowest first.
+		 */
+		std::unique_ptr<lane[]> lanes;
+		
+		/**
+		 * \brief The number of limited drains that may starve a lower lane in a row.
+		 */
+		const std::size_t starvationLimit;
+		
+		/**
+		 * \brief The number of limited drains in a row that starved a lower lane.
+		 * 
+		 * Only touched by the consumer.
+		 */
+		std::size_t starvedDrains;
+		
+		/**
+		 * \brief The maximum number of items held, zero for no limit.
+		 */
+		const std::size_t maxItems;
+		
+		/**
+		 * \brief The maximum number of data bytes held, zero for no limit.
+		 */
+		const std::size_t maxBytes;
+		
+		/**
+		 * \brief What a push does when a limit would be exceeded.
+		 */
+		const overflow_policy overflow;
+		
+		/**
+		 * \brief The number of items currently within the store.
+		 */
+		std::atomic<std::size_t> count;
+		
+		/**
+		 * \brief The number of data bytes currently within the store.
 		 */
-		std::queue<buffer_item> queue;
+		std::atomic<std::size_t> byteCount;
 		
 		/**
-		 * \brief \todo
+		 * \brief The most items ever held at once.
 		 */
-		std::mutex queueMutex;
+		std::atomic<std::size_t> highWaterItems;
 		
 		/**
-		 * \brief \todo
+		 * \brief The most data bytes ever held at once.
+		 */
+		std::atomic<std::size_t> highWaterBytes;
+		
+		/**
+		 * \brief Items discarded by an overflow policy.
+		 */
+		std::atomic<std::uint64_t> droppedItems;
+		
+		/**
+		 * \brief Pushes that had to wait for room.
+		 */
+		std::atomic<std::uint64_t> blockedPushes;
+		
+		/**
+		 * \brief Mutex used by blocked producers to wait for room.
+		 */
+		std::mutex spaceMutex;
+		
+		/**
+		 * \brief Condition variable signaled when the consumer makes room.
+		 */
+		std::condition_variable spaceCV;
+		
+		/**
+		 * \brief The number of producers currently waiting for room.
+		 * 
+		 * Lets the consumer skip signaling when nobody is blocked.
+		 */
+		std::atomic<std::size_t> blockedProducers;
+		
+		/**
+		 * \brief The number of times the consumer has made room.
+		 * 
+		 * Lets a producer refused by a full store wait for the next release.
+		 */
+		std::atomic<std::size_t> releases;
+		
+		/**
+		 * \brief Whether or not blocking pushes should give up.
+		 */
+		std::atomic_bool interrupted;
+		
+		/**
+		 * \brief The journal spilled items are written to, NULL unless the spill
+		 * overflow policy is used.
+		 */
+		std::unique_ptr<spill_journal> journal;
+		
+		/**
+		 * \brief Mutex protector of the journal and of changes to spilling.
+		 */
+		std::mutex spillMutex;
+		
+		/**
+		 * \brief Whether or not pushes go to the journal.
+		 * 
+		 * Set by the first spill and cleared when the consumer empties the journal.
+		 */
+		std::atomic_bool spilling;
+		
+		/**
+		 * \brief The number of items in the journal.
+		 */
+		std::atomic<std::size_t> journalCount;
+		
+		/**
+		 * \brief Items written to the journal.
+		 */
+		std::atomic<std::uint64_t> spilledItems;
+		
+		/**
+		 * \brief Mutex used only by the consumer to wait and by producers to signal
+		 * the consumer.
+		 * 
+		 * Producers do not take this on every push, only when crossing the push wait
+		 * threshold.
+		 */
+		std::mutex waitMutex;
+		
+		/**
+		 * \brief Condition variable signaled when the push wait threshold is reached.
 		 */
 		std::condition_variable pushCV;
 		
 		/**
-		 * \brief \todo
+		 * \brief Whether or not an item was pushed above lane zero since the last
+		 * successful push_wait().
+		 */
+		std::atomic_bool urgentPending;
+		
+		/**
+		 * \brief Whether or not a push wait threshold has been set.
+		 */
+		std::atomic_bool pushWaitEnabled;
+		
+		/**
+		 * \brief The number of items pushed since the last drain, successful
+		 * push_wait(), cleared push event or change of threshold.
 		 */
-		std::condition_variable pushWaitCV;
+		std::atomic<std::size_t> pushWaitNew;
 		
 		/**
-		 * \brief \todo
+		 * \brief The number of new items required for push_wait() to succeed.
 		 */
-		bool pushWaitEnabled;
+		std::atomic<std::size_t> pushWaitThreshold;
 		
 		/**
-		 * \brief \todo
+		 * \brief Whether or not the threshold was signaled since pushWaitNew was last
+		 * reset, so it is signaled once however far it is passed.
+		 */
+		std::atomic_bool pushWaitSignaled;
+		
+		/**
+		 * \brief The eventfd signaled alongside pushCV.
+		 */
+		int pushEvent;
+		
+		/**
+		 * \brief Whether or not the next push signals the push event.
+		 */
+		std::atomic_bool pushEventArmed;
+		
+		/**
+		 * \brief Instantiate the store of a lane for a configuration.
+		 * 
+		 * \throws If the configuration is invalid we throw an invalid_argument.
+		 */
+		static istore* make_store(const config& configuration);
+		
+		/**
+		 * \brief Return the lane count of a configuration once validated.
+		 * 
+		 * \throws If the lane count is out of range we throw an invalid_argument.
+		 */
+		static std::size_t checked_lanes(const config& configuration);
+		
+		/**
+		 * \brief Pop from one lane whatever still fits in a drain limited to maxItems
+		 * which started when out held before items.
+		 * 
+		 * \returns The total size of the data of the moved items.
+		 */
+		std::size_t pop_lane(const std::size_t index,
+				std::vector<buffer_item>& out,
+				const std::size_t maxItems,
+				const std::size_t before);
+		
+		/**
+		 * \brief Return whether or not an item of some size fits within the limits.
+		 */
+		inline bool has_room(const std::size_t itemCount,
+				const std::size_t itemBytes) const {
+			return (maxItems == 0 || itemCount <= maxItems) &&
+					(maxBytes == 0 || itemBytes <= maxBytes);
+		}
+		
+		/**
+		 * \brief Account for an item against the limits, applying the overflow policy
+		 * if it does not fit.
+		 * 
+		 * \returns Whether or not the item was accounted for and may be stored.
+		 */
+		bool reserve(const std::size_t itemBytes);
+		
+		/**
+		 * \brief Push an accounted item into the store of a lane.
+		 * 
+		 * A full store is waited on under the block policy until it has room or the
+		 * buffer is interrupted, and refuses the item under any other policy. A
+		 * refused item is left as it was.
+		 * 
+		 * \returns Whether or not the item was stored.
+		 */
+		bool store_item(lane& target, buffer_item& item);
+		
+		/**
+		 * \brief Release the accounting of items taken out by the consumer.
+		 */
+		void release(const std::size_t itemCount, const std::size_t itemBytes);
+		
+		/**
+		 * \brief Signal a consumer waiting in push_wait() or polling the push event that
+		 * an item was pushed.
+		 */
+		void signal_push(const std::size_t priority);
+		
+		/**
+		 * \brief Start counting new items towards the push wait threshold again.
+		 */
+		inline void reset_push_wait() {
+			pushWaitNew.store(0);
+			pushWaitSignaled.store(false);
+		}
+		
+		/**
+		 * \brief Make the push event readable.
+		 */
+		void signal_push_event();
+		
+		/**
+		 * \brief Append an item to the journal.
+		 * 
+		 * Unless force is set the item is only appended when already spilling.
+		 * 
+		 * \returns Whether the item was appended, was not because nothing is being
+		 * spilled, or could not be appended.
+		 */
+		spill_result spill(const buffer_item& item, const bool force);
+		
+		/**
+		 * \brief Read up to maxItems spilled items onto the back of out, or all of
+		 * them if maxItems is zero.
+		 * 
+		 * \returns The number of items read.
 		 */
-		std::size_t pushWaitNew;
+		std::size_t replay(std::vector<buffer_item>& out, const std::size_t maxItems);
 		
 		/**
-		 * \brief \todo
+		 * \brief Raise a high water mark to value if it is higher.
 		 */
-		std::size_t pushWaitThreshold;
+		static void raise_high_water(std::atomic<std::size_t>& mark,
+				const std::size_t value);
 	};
 }
 
@@ -0,0 +1,308 @@
+#include "slab_allocator.hpp"
+
+/**
+ * \brief The payload sizes of each size class.
+ * 
+ * Detector events are normally tens of bytes, so the classes are weighted small.
+ */
+#define BUFFER_SLAB_CLASSES {64, 256, 1024, 4096, 16384}
+
+/**
+ * \brief The number of size classes.
+ */
+#define BUFFER_SLAB_CLASS_COUNT 5
+
+/**
+ * \brief The size of a slab allocated to refill a free list.
+ * 
+ * \note Bytes.
+ */
+#define BUFFER_SLAB_SIZE 65536
+
+/**
+ * \brief The size class marker of a payload allocated directly from the heap.
+ */
+#define BUFFER_SLAB_HEAP_CLASS BUFFER_SLAB_CLASS_COUNT
+
+namespace buffer {
+	namespace {
+		/**
+		 * \brief The payload sizes of each size class.
+		 */
+		const std::size_t classSizes[BUFFER_SLAB_CLASS_COUNT] = BUFFER_SLAB_CLASSES;
+		
+		/**
+		 * \brief Return the smallest size class that fits size, or the heap class.
+		 */
+		inline std::size_t class_of(const std::size_t size) {
+			for(std::size_t i = 0; i < BUFFER_SLAB_CLASS_COUNT; i++) {
+				if(size <= classSizes[i]) {
+					return i;
+				}
+			}
+			
+			return BUFFER_SLAB_HEAP_CLASS;
+		}
+	}
+	
+	struct slab_allocator::block_header {
+	 public:
+		/**
+		 * \brief The arena the block is returned to, NULL for heap payloads.
+		 */
+		arena* owner;
+		
+		/**
+		 * \brief The size class of the block.
+		 */
+		std::size_t sizeClass;
+		
+		/**
+		 * \brief The next block when on a free list.
+		 */
+		block_header* next;
+		
+		/**
+		 * \brief Keeps payloads 16 byte aligned.
+		 */
+		std::size_t padding;
+		
+		/**
+		 * \brief Return the payload following the header.
+		 */
+		inline char* payload() {
+			return reinterpret_cast<char*>(this + 1);
+		}
+		
+		/**
+		 * \brief Return the header preceding a payload.
+		 */
+		static inline block_header* of(char* const payload) {
+			return reinterpret_cast<block_header*>(payload) - 1;
+		}
+	};
+	
+	struct slab_allocator::arena {
+	 public:
+		/**
+		 * \brief Constructor.
+		 */
+		arena()
+				: leased(false),
+				localFree{},
+				remoteFree{},
+				allocations(0),
+				deallocations(0),
+				slabRefills(0),
+				heapAllocations(0),
+				remoteDeallocations(0) {
+			for(auto& head : remoteFree) {
+				head.store(NULL, std::memory_order_relaxed);
+			}
+		}
+		
+		/**
+		 * \brief Whether or not a thread currently holds the lease on the arena.
+		 */
+		std::atomic_bool leased;
+		
+		/**
+		 * \brief Free lists only touched by the leasing thread.
+		 */
+		block_header* localFree[BUFFER_SLAB_CLASS_COUNT];
+		
+		/**
+		 * \brief Free lists other threads push returned blocks onto.
+		 */
+		std::atomic<block_header*> remoteFree[BUFFER_SLAB_CLASS_COUNT];
+		
+		/**
+		 * \brief Slabs carved into blocks, kept for the life of the process.
+		 */
+		std::vector<char*> slabs;
+		
+		/**
+		 * \brief Counters written only by the leasing thread.
+		 */
+		std::atomic<std::uint64_t> allocations;
+		std::atomic<std::uint64_t> deallocations;
+		std::atomic<std::uint64_t> slabRefills;
+		std::atomic<std::uint64_t> heapAllocations;
+		
+		/**
+		 * \brief Counter written by other threads.
+		 */
+		std::atomic<std::uint64_t> remoteDeallocations;
+		
+		/**
+		 * \brief Pop a block of a size class, refilling the free list if it is empty.
+		 * 
+		 * \warning Only call from the leasing thread.
+		 */
+		block_header* pop(const std::size_t sizeClass) {
+			auto block = localFree[sizeClass];
+			
+			if(UNLIKELY(block == NULL)) {
+				// Reclaim everything other threads have returned in one exchange
+				block = remoteFree[sizeClass].exchange(NULL, std::memory_order_acquire);
+				
+				if(block == NULL) {
+					block = refill(sizeClass);
+				}
+			}
+			
+			localFree[sizeClass] = block->next;
+			
+			return block;
+		}
+		
+		/**
+		 * \brief Carve a new slab into blocks of a size class and return the list.
+		 * 
+		 * \warning Only call from the leasing thread.
+		 */
+		block_header* refill(const std::size_t sizeClass) {
+			const auto stride = sizeof(block_header) + classSizes[sizeClass];
+			const auto count = stride < BUFFER_SLAB_SIZE ? BUFFER_SLAB_SIZE / stride : 1;
+			
+			auto slab = new char[stride * count];
+			slabs.push_back(slab);
+			relaxed_increment(slabRefills);
+			
+			block_header* head = NULL;
+			for(std::size_t i = count; i > 0; i--) {
+				auto block = reinterpret_cast<block_header*>(slab + (i - 1) * stride);
+				block->owner = this;
+				block->sizeClass = sizeClass;
+				block->next = head;
+				head = block;
+			}
+			
+			return head;
+		}
+		
+		/**
+		 * \brief Increment a counter only ever written by one thread.
+		 */
+		static inline void relaxed_increment(std::atomic<std::uint64_t>& counter) {
+			counter.store(counter.load(std::memory_order_relaxed) + 1,
+					std::memory_order_relaxed);
+		}
+	};
+	
+	thread_local slab_allocator::arena_lease slab_allocator::lease;
+	std::vector<slab_allocator::arena*> slab_allocator::arenas;
+	std::mutex slab_allocator::arenasMutex;
+	std::atomic<std::uint64_t> slab_allocator::orphanDeallocations(0);
+	
+	slab_allocator::arena_lease::arena_lease()
+			: leased(NULL) {
+	}
+	
+	slab_allocator::arena_lease::~arena_lease() {
+		if(leased != NULL) {
+			leased->leased.store(false, std::memory_order_release);
+		}
+	}
+	
+	char* slab_allocator::allocate(const std::size_t size) {
+		auto& local = local_arena();
+		arena::relaxed_increment(local.allocations);
+		
+		const auto sizeClass = class_of(size);
+		block_header* block;
+		
+		if(LIKELY(sizeClass != BUFFER_SLAB_HEAP_CLASS)) {
+			block = local.pop(sizeClass);
+		} else {
+			block = reinterpret_cast<block_header*>(new char[sizeof(block_header) + size]);
+			block->owner = NULL;
+			block->sizeClass = BUFFER_SLAB_HEAP_CLASS;
+			arena::relaxed_increment(local.heapAllocations);
+		}
+		
+		return block->payload();
+	}
+	
+	void slab_allocator::deallocate(char* const payload) {
+		if(payload == NULL) {
+			return;
+		}
+		
+		auto block = block_header::of(payload);
+		auto owner = block->owner;
+		
+		if(UNLIKELY(owner == NULL)) {
+			if(lease.leased != NULL) {
+				arena::relaxed_increment(lease.leased->deallocations);
+			} else {
+				orphanDeallocations.fetch_add(1, std::memory_order_relaxed);
+			}
+			
+			delete[] reinterpret_cast<char*>(block);
+		} else if(owner == lease.leased) {
+			block->next = owner->localFree[block->sizeClass];
+			owner->localFree[block->sizeClass] = block;
+			arena::relaxed_increment(owner->deallocations);
+		} else {
+			auto& head = owner->remoteFree[block->sizeClass];
+			block->next = head.load(std::memory_order_relaxed);
+			
+			// Push only, the owner takes the whole list at once, so there is no ABA
+			while(!head.compare_exchange_weak(block->next,
+					block,
+					std::memory_order_release,
+					std::memory_order_relaxed)) {
+			}
+			
+			owner->remoteDeallocations.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	
+	slab_allocator::stats slab_allocator::statistics() {
+		std::lock_guard<std::mutex> lock(arenasMutex);
+		
+		stats result = {0, 0, 0, 0, 0, 0};
+		
+		for(auto a : arenas) {
+			result.allocations += a->allocations.load(std::memory_order_relaxed);
+			result.deallocations += a->deallocations.load(std::memory_order_relaxed);
+			result.remoteDeallocations +=
+					a->remoteDeallocations.load(std::memory_order_relaxed);
+			result.slabRefills += a->slabRefills.load(std::memory_order_relaxed);
+			result.heapAllocations += a->heapAllocations.load(std::memory_order_relaxed);
+		}
+		
+		result.deallocations += result.remoteDeallocations;
+		result.deallocations += orphanDeallocations.load(std::memory_order_relaxed);
+		result.arenas = arenas.size();
+		
+		return result;
+	}
+	
+	slab_allocator::arena& slab_allocator::local_arena() {
+		if(LIKELY(lease.leased != NULL)) {
+			return *lease.leased;
+		}
+		
+		std::lock_guard<std::mutex> lock(arenasMutex);
+		
+		// Prefer an arena given back by an exited thread, its free lists are warm
+		for(auto a : arenas) {
+			bool expected = false;
+			if(a->leased.compare_exchange_strong(expected,
+					true,
+					std::memory_order_acquire)) {
+				lease.leased = a;
+				return *a;
+			}
+		}
+		
+		auto a = new arena();
+		a->leased.store(true, std::memory_order_relaxed);
+		arenas.push_back(a);
+		lease.leased = a;
+		
+		return *a;
+	}
+}
@@ -0,0 +1,151 @@
+#ifndef _BUFFER_SLAB_ALLOCATOR_HPP
+#define _BUFFER_SLAB_ALLOCATOR_HPP
+
+#include <common.hpp>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace buffer {
+	/**
+	 * \brief A size-classed allocator for buffer item payloads.
+	 * 
+	 * Each thread that allocates is leased an arena holding a free list per size class.
+	 * Free lists are refilled a whole slab at a time, so in the steady state an
+	 * allocation is a pop from a thread-local list and never reaches the heap. Blocks
+	 * freed on a thread other than the one owning their arena, as happens when zmq
+	 * frees a sent message, are returned to the owning arena through a lock-free list
+	 * which the owner reclaims when its local list runs dry.
+	 * 
+	 * Arenas are leased rather than owned by threads, so an arena outlives the thread
+	 * that used it and is picked up by the next producer thread.
+	 * 
+	 * Payloads larger than the biggest size class come from the heap.
+	 */
+	class slab_allocator {
+	 public:
+		/**
+		 * \brief A snapshot of the allocation counters summed over every arena.
+		 */
+		struct stats {
+		 public:
+			/**
+			 * \brief Payloads handed out.
+			 */
+			std::uint64_t allocations;
+			
+			/**
+			 * \brief Payloads given back.
+			 */
+			std::uint64_t deallocations;
+			
+			/**
+			 * \brief Payloads given back on a thread that did not own their arena.
+			 */
+			std::uint64_t remoteDeallocations;
+			
+			/**
+			 * \brief Slabs allocated from the heap to refill a free list.
+			 */
+			std::uint64_t slabRefills;
+			
+			/**
+			 * \brief Payloads too large for a size class and allocated from the heap.
+			 */
+			std::uint64_t heapAllocations;
+			
+			/**
+			 * \brief Number of arenas created.
+			 */
+			std::uint64_t arenas;
+		};
+		
+		/**
+		 * \brief Allocation is static only.
+		 */
+		slab_allocator() = delete;
+		
+		/**
+		 * \brief Allocate a payload of at least size bytes.
+		 * 
+		 * \note Threadsafe.
+		 */
+		static char* allocate(const std::size_t size);
+		
+		/**
+		 * \brief Give back a payload returned by allocate().
+		 * 
+		 * Safe to call on any thread and with a null pointer.
+		 * 
+		 * \note Threadsafe.
+		 */
+		static void deallocate(char* const payload);
+		
+		/**
+		 * \brief Return a snapshot of the allocation counters.
+		 * 
+		 * \note Threadsafe, but counters are read without stopping other threads.
+		 */
+		static stats statistics();
+	
+	 private:
+		/**
+		 * \brief The per-thread free lists, defined in the implementation.
+		 */
+		struct arena;
+		
+		/**
+		 * \brief The header preceding every payload, defined in the implementation.
+		 */
+		struct block_header;
+		
+		/**
+		 * \brief Holds a thread's lease on an arena and gives it back at thread exit.
+		 */
+		struct arena_lease {
+		 public:
+			/**
+			 * \brief Constructor.
+			 */
+			arena_lease();
+			
+			/**
+			 * \brief Destructor gives the arena back for another thread to lease.
+			 */
+			~arena_lease();
+			
+			/**
+			 * \brief The leased arena, NULL until the thread first allocates.
+			 */
+			arena* leased;
+		};
+		
+		/**
+		 * \brief The calling thread's lease.
+		 */
+		static thread_local arena_lease lease;
+		
+		/**
+		 * \brief Every arena ever created.
+		 */
+		static std::vector<arena*> arenas;
+		
+		/**
+		 * \brief Mutex protector of the arena list.
+		 */
+		static std::mutex arenasMutex;
+		
+		/**
+		 * \brief Heap payloads freed on threads that never allocated.
+		 */
+		static std::atomic<std::uint64_t> orphanDeallocations;
+		
+		/**
+		 * \brief Return the arena leased to the calling thread, leasing one if needed.
+		 */
+		static arena& local_arena();
+	};
+}
+
+#endif
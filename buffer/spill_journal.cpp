@@ -0,0 +1,175 @@
+#include "spill_journal.hpp"
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace buffer {
+	namespace {
+		/**
+		 * \brief Numbers the journals created by the process.
+		 */
+		std::atomic<std::size_t> journalCounter(0);
+	}
+	
+	spill_journal::spill_journal(const std::string& directory,
+			const std::size_t segmentSize)
+			: directory(directory),
+			segmentSize(segmentSize),
+			journalId(journalCounter.fetch_add(1)),
+			segmentSerial(0),
+			pending(0) {
+		if(UNLIKELY(segmentSize == 0)) {
+			throw std::invalid_argument(err_msg::_zrlngth);
+		}
+		
+		// Record lengths must fit in a field
+		if(UNLIKELY(segmentSize > std::numeric_limits<field_t>::max())) {
+			throw std::invalid_argument(err_msg::_arybnds);
+		}
+	}
+	
+	spill_journal::~spill_journal() {
+		while(!segments.empty()) {
+			close_segment();
+		}
+	}
+	
+	bool spill_journal::append(const buffer_item& item) {
+		// A record is its length followed by the data size, the parameter count, the
+		// size of the flattened parameters, the flattened parameters, and the data
+		const auto& itemParameters = item.parameters();
+		const auto recordSize = 4 * sizeof(field_t) + itemParameters.packed_size() +
+				item.size();
+		
+		if(UNLIKELY(recordSize > segmentSize)) {
+			return false;
+		}
+		
+		if(segments.empty() ||
+				segmentSize - segments.back().writeOffset < recordSize) {
+			if(UNLIKELY(!open_segment())) {
+				return false;
+			}
+		}
+		
+		auto& target = segments.back();
+		auto offset = target.writeOffset;
+		
+		put_field(target.base, offset, recordSize - sizeof(field_t));
+		put_field(target.base, offset, item.size());
+		put_field(target.base, offset, itemParameters.size());
+		put_field(target.base, offset, itemParameters.packed_size());
+		
+		memcpy(target.base + offset, itemParameters.packed(), itemParameters.packed_size());
+		offset += itemParameters.packed_size();
+		
+		if(item.size() != 0) {
+			memcpy(target.base + offset, item.data(), item.size());
+		}
+		
+		target.writeOffset += recordSize;
+		pending++;
+		
+		return true;
+	}
+	
+	bool spill_journal::read(std::vector<buffer_item>& out) {
+		if(pending == 0) {
+			return false;
+		}
+		
+		if(segments.front().readOffset == segments.front().writeOffset) {
+			// Every record of a segment other than the last has been read
+			close_segment();
+		}
+		
+		auto& source = segments.front();
+		auto offset = source.readOffset;
+		
+		const auto bodySize = get_field(source.base, offset);
+		const auto dataSize = get_field(source.base, offset);
+		const auto parameterCount = get_field(source.base, offset);
+		const auto packedSize = get_field(source.base, offset);
+		
+		auto itemParameters = parameters::unpack(source.base + offset,
+				packedSize,
+				parameterCount);
+		offset += packedSize;
+		
+		out.push_back(buffer_item(source.base + offset,
+				dataSize,
+				std::move(itemParameters)));
+		
+		source.readOffset += sizeof(field_t) + bodySize;
+		pending--;
+		
+		if(pending == 0) {
+			// Start the next spill with a fresh segment rather than an emptied one
+			while(!segments.empty()) {
+				close_segment();
+			}
+		}
+		
+		return true;
+	}
+	
+	bool spill_journal::open_segment() {
+		segment created;
+		created.path = directory + "/af-spill-" + std::to_string(getpid()) + "-" +
+				std::to_string(journalId) + "-" + std::to_string(segmentSerial++);
+		created.writeOffset = 0;
+		created.readOffset = 0;
+		
+		const auto fd = open(created.path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+		if(UNLIKELY(fd < 0)) {
+			return false;
+		}
+		
+		void* mapping = MAP_FAILED;
+		if(ftruncate(fd, segmentSize) == 0) {
+			mapping = mmap(0, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		}
+		
+		// The mapping keeps the file alive
+		close(fd);
+		
+		if(UNLIKELY(mapping == MAP_FAILED)) {
+			unlink(created.path.c_str());
+			return false;
+		}
+		
+		madvise(mapping, segmentSize, MADV_SEQUENTIAL);
+		created.base = static_cast<char*>(mapping);
+		segments.push_back(std::move(created));
+		
+		return true;
+	}
+	
+	void spill_journal::close_segment() {
+		auto& front = segments.front();
+		
+		munmap(front.base, segmentSize);
+		unlink(front.path.c_str());
+		
+		segments.pop_front();
+	}
+	
+	void spill_journal::put_field(char* const base,
+			std::size_t& offset,
+			const std::size_t value) {
+		const auto field = static_cast<field_t>(value);
+		memcpy(base + offset, &field, sizeof(field));
+		offset += sizeof(field);
+	}
+	
+	std::size_t spill_journal::get_field(const char* const base, std::size_t& offset) {
+		field_t field;
+		memcpy(&field, base + offset, sizeof(field));
+		offset += sizeof(field);
+		
+		return field;
+	}
+}
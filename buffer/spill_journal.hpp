@@ -0,0 +1,180 @@
+#ifndef _BUFFER_SPILL_JOURNAL_HPP
+#define _BUFFER_SPILL_JOURNAL_HPP
+
+#include <common.hpp>
+#include "buffer_item.hpp"
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace buffer {
+	/**
+	 * \brief An on-disk FIFO of buffer items made of memory mapped segment files.
+	 * 
+	 * Items are appended as length-prefixed records holding the parameters and the
+	 * data. Segments are fixed size files created in a directory as they are needed and
+	 * removed as soon as every record in them has been read, so the disk used follows
+	 * the backlog. The journal only relieves memory; it is not recovered after a
+	 * restart and any segments left are removed on destruction.
+	 * 
+	 * \note Not threadsafe, the owner serializes appends and reads.
+	 */
+	class spill_journal {
+	 public:
+		/**
+		 * \brief Constructor.
+		 * 
+		 * Nothing is created on disk until the first append.
+		 * 
+		 * \throws If the segment size is zero or does not fit in a record length field
+		 * we throw an invalid_argument.
+		 */
+		spill_journal(const std::string& directory, const std::size_t segmentSize);
+		
+		/**
+		 * \brief Copy constructor is disabled.
+		 */
+		spill_journal(const spill_journal&) = delete;
+		
+		/**
+		 * \brief Move constructor is disabled.
+		 */
+		spill_journal(spill_journal&&) = delete;
+		
+		/**
+		 * \brief Assignment operator is disabled.
+		 */
+		spill_journal& operator=(const spill_journal&) = delete;
+		
+		/**
+		 * \brief Move assignment operator is disabled.
+		 */
+		spill_journal& operator=(spill_journal&&) = delete;
+		
+		/**
+		 * \brief Destructor unmaps and removes every segment.
+		 */
+		~spill_journal();
+		
+		/**
+		 * \brief Append an item to the back of the journal.
+		 * 
+		 * \returns Whether or not the item was written. An item whose record is larger
+		 * than a segment, or a failure to create a segment, leaves the journal as it
+		 * was.
+		 */
+		bool append(const buffer_item& item);
+		
+		/**
+		 * \brief Read the item at the front of the journal onto the back of out.
+		 * 
+		 * \returns Whether or not there was an item to read.
+		 */
+		bool read(std::vector<buffer_item>& out);
+		
+		/**
+		 * \brief Return the number of items in the journal.
+		 */
+		inline std::size_t size() const {
+			return pending;
+		}
+		
+		/**
+		 * \brief Return whether or not the journal holds no items.
+		 */
+		inline bool empty() const {
+			return pending == 0;
+		}
+	
+	 private:
+		/**
+		 * \brief The type of a record length or count field.
+		 */
+		using field_t = std::uint32_t;
+		
+		/**
+		 * \brief A mapped segment file.
+		 */
+		struct segment {
+		 public:
+			/**
+			 * \brief The path of the file.
+			 */
+			std::string path;
+			
+			/**
+			 * \brief The start of the mapping.
+			 */
+			char* base;
+			
+			/**
+			 * \brief The offset records are appended at.
+			 */
+			std::size_t writeOffset;
+			
+			/**
+			 * \brief The offset of the next record to read.
+			 */
+			std::size_t readOffset;
+		};
+		
+		/**
+		 * \brief The directory segments are created in.
+		 */
+		const std::string directory;
+		
+		/**
+		 * \brief The size of every segment.
+		 * 
+		 * \note Bytes.
+		 */
+		const std::size_t segmentSize;
+		
+		/**
+		 * \brief Distinguishes the segment files of journals within one process.
+		 */
+		const std::size_t journalId;
+		
+		/**
+		 * \brief The number of segments created so far, used to name the next one.
+		 */
+		std::size_t segmentSerial;
+		
+		/**
+		 * \brief The live segments, read from the front and appended to at the back.
+		 */
+		std::deque<segment> segments;
+		
+		/**
+		 * \brief The number of items in the journal.
+		 */
+		std::size_t pending;
+		
+		/**
+		 * \brief Create, size, and map a new segment at the back.
+		 * 
+		 * \returns Whether or not the segment was created.
+		 */
+		bool open_segment();
+		
+		/**
+		 * \brief Unmap and remove the segment at the front.
+		 */
+		void close_segment();
+		
+		/**
+		 * \brief Write a field at an offset within a segment.
+		 */
+		static void put_field(char* const base,
+				std::size_t& offset,
+				const std::size_t value);
+		
+		/**
+		 * \brief Read a field at an offset within a segment.
+		 */
+		static std::size_t get_field(const char* const base, std::size_t& offset);
+	};
+}
+
+#endif
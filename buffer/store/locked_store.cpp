@@ -0,0 +1,85 @@
+#include "locked_store.hpp"
+
+namespace buffer {
+	namespace store {
+		locked_store::locked_store()
+				: head(0),
+				queueBytes(0) {
+		}
+		
+		locked_store::~locked_store() {
+		}
+		
+		bool locked_store::push(buffer_item&& item) {
+			lock_t lock(queueMutex);
+			
+			queueBytes += item.size();
+			queue.push_back(std::move(item));
+			
+			return true;
+		}
+		
+		std::size_t locked_store::pop(std::vector<buffer_item>& out,
+				const std::size_t maxItems) {
+			lock_t lock(queueMutex);
+			
+			const auto available = queue.size() - head;
+			
+			if(available == 0) {
+				return 0;
+			}
+			
+			if(head == 0 && out.empty() && (maxItems == 0 || maxItems >= available)) {
+				// Cheapest case, which is also the common one
+				const auto result = queueBytes;
+				queueBytes = 0;
+				std::swap(queue, out);
+				
+				return result;
+			}
+			
+			const auto taken = (maxItems == 0 || maxItems > available) ?
+					available : maxItems;
+			std::size_t result = 0;
+			
+			for(std::size_t i = head; i < head + taken; i++) {
+				result += queue[i].size();
+				out.push_back(std::move(queue[i]));
+			}
+			
+			head += taken;
+			queueBytes -= result;
+			compact();
+			
+			return result;
+		}
+		
+		bool locked_store::drop_front(std::size_t& itemBytes) {
+			lock_t lock(queueMutex);
+			
+			if(head == queue.size()) {
+				return false;
+			}
+			
+			itemBytes = queue[head].size();
+			queueBytes -= itemBytes;
+			
+			// Moving out releases the data now rather than at compaction
+			buffer_item dropped(std::move(queue[head]));
+			head++;
+			compact();
+			
+			return true;
+		}
+		
+		void locked_store::compact() {
+			if(head == queue.size()) {
+				queue.clear();
+				head = 0;
+			} else if(head > queue.size() / 2) {
+				queue.erase(queue.begin(), queue.begin() + head);
+				head = 0;
+			}
+		}
+	}
+}
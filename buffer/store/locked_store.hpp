@@ -0,0 +1,94 @@
+#ifndef _BUFFER_STORE_LOCKED_STORE_HPP
+#define _BUFFER_STORE_LOCKED_STORE_HPP
+
+#include <common.hpp>
+#include "../istore.hpp"
+#include <mutex>
+#include <vector>
+
+namespace buffer {
+	namespace store {
+		/**
+		 * \brief An unbounded store that serializes producers and the consumer on a
+		 * single mutex.
+		 */
+		class locked_store : public ::buffer::istore {
+		 private:
+			/**
+			 * \brief Standard mutex lock type for the class.
+			 */
+			using lock_t = std::lock_guard<std::mutex>;
+		
+		 public:
+			/**
+			 * \brief Constructor.
+			 */
+			locked_store();
+			
+			/**
+			 * \brief Destructor.
+			 */
+			~locked_store();
+			
+			/**
+			 * \brief Push an item into the store.
+			 * 
+			 * This always succeeds.
+			 * 
+			 * \note Threadsafe.
+			 */
+			bool push(buffer_item&& item);
+			
+			/**
+			 * \brief Move up to maxItems of the oldest items within the store onto the
+			 * back of out, or every one if maxItems is zero.
+			 * 
+			 * When out is empty and everything is taken the vectors are swapped, so the
+			 * store and the consumer trade allocations back and forth rather than making
+			 * new ones.
+			 * 
+			 * \note Threadsafe.
+			 */
+			std::size_t pop(std::vector<buffer_item>& out, const std::size_t maxItems);
+			
+			/**
+			 * \brief Discard the oldest item within the store.
+			 * 
+			 * \note Threadsafe.
+			 */
+			bool drop_front(std::size_t& itemBytes);
+		
+		 private:
+			/**
+			 * \brief The items in the store, the oldest at index head.
+			 */
+			std::vector<buffer_item> queue;
+			
+			/**
+			 * \brief The index of the oldest item in the queue.
+			 * 
+			 * Items before it have been moved out and are left for compact() to erase.
+			 */
+			std::size_t head;
+			
+			/**
+			 * \brief The total size of the data of the items in the queue.
+			 */
+			std::size_t queueBytes;
+			
+			/**
+			 * \brief Mutex protector of the queue.
+			 */
+			std::mutex queueMutex;
+			
+			/**
+			 * \brief Erase the items before head once they are most of the queue.
+			 * 
+			 * \warning queueMutex must be held.
+			 */
+			void compact();
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,104 @@
+#include "ring_store.hpp"
+#include <cstdint>
+
+namespace buffer {
+	namespace store {
+		ring_store::ring_store(const std::size_t capacity)
+				: slots(new slot[round_up(capacity)]),
+				mask(round_up(capacity) - 1),
+				padding0{0},
+				enqueuePos(0),
+				padding1{0},
+				dequeuePos(0) {
+			for(std::size_t i = 0; i <= mask; i++) {
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+		
+		ring_store::~ring_store() {
+			std::vector<buffer_item> leftover;
+			pop(leftover, 0);
+			
+			delete[] slots;
+		}
+		
+		bool ring_store::push(buffer_item&& item) {
+			auto pos = enqueuePos.load(std::memory_order_relaxed);
+			slot* s;
+			
+			for(;;) {
+				s = &slots[pos & mask];
+				const auto seq = s->sequence.load(std::memory_order_acquire);
+				const auto diff = static_cast<std::intptr_t>(seq) -
+						static_cast<std::intptr_t>(pos);
+				
+				if(diff == 0) {
+					// The slot is free on this lap, try to claim it
+					if(enqueuePos.compare_exchange_weak(pos,
+							pos + 1,
+							std::memory_order_relaxed)) {
+						break;
+					}
+				} else if(diff < 0) {
+					// The consumer has not freed this slot from the last lap
+					return false;
+				} else {
+					// Another producer claimed the slot first
+					pos = enqueuePos.load(std::memory_order_relaxed);
+				}
+			}
+			
+			new (&s->storage) buffer_item(std::move(item));
+			
+			// Publish to the consumer
+			s->sequence.store(pos + 1, std::memory_order_release);
+			
+			return true;
+		}
+		
+		std::size_t ring_store::pop(std::vector<buffer_item>& out,
+				const std::size_t maxItems) {
+			std::size_t result = 0;
+			
+			for(std::size_t taken = 0; maxItems == 0 || taken < maxItems; taken++) {
+				auto& s = slots[dequeuePos & mask];
+				const auto seq = s.sequence.load(std::memory_order_acquire);
+				
+				if(seq != dequeuePos + 1) {
+					// Either empty or a producer has claimed but not yet published the
+					// slot, in which case we pick it up on the next drain
+					return result;
+				}
+				
+				auto& item = item_in(s);
+				result += item.size();
+				out.push_back(std::move(item));
+				item.~buffer_item();
+				
+				// Free the slot for the next lap
+				s.sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+				dequeuePos++;
+			}
+			
+			return result;
+		}
+		
+		bool ring_store::drop_front(std::size_t&) {
+			// Only the consumer may advance the dequeue position
+			return false;
+		}
+		
+		std::size_t ring_store::round_up(const std::size_t value) {
+			if(UNLIKELY(value == 0)) {
+				throw std::invalid_argument(err_msg::_zrlngth);
+			}
+			
+			std::size_t result = 1;
+			while(result < value) {
+				result <<= 1;
+			}
+			
+			return result;
+		}
+	}
+}
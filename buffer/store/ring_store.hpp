@@ -0,0 +1,135 @@
+#ifndef _BUFFER_STORE_RING_STORE_HPP
+#define _BUFFER_STORE_RING_STORE_HPP
+
+#include <common.hpp>
+#include "../istore.hpp"
+#include <atomic>
+#include <type_traits>
+
+namespace buffer {
+	namespace store {
+		/**
+		 * \brief A bounded lock-free multi-producer/single-consumer ring.
+		 * 
+		 * Each slot carries a sequence number which tells a producer whether the slot is
+		 * free for the lap it is on and tells the consumer whether the slot has been
+		 * published. Producers only contend on a single atomic index with a CAS and
+		 * never block the consumer, and the consumer never blocks producers.
+		 */
+		class ring_store : public ::buffer::istore {
+		 public:
+			/**
+			 * \brief Constructor takes the number of slots in the ring.
+			 * 
+			 * The capacity is rounded up to the next power of two.
+			 * 
+			 * \throws If capacity is zero we throw an invalid_argument.
+			 */
+			ring_store(const std::size_t capacity);
+			
+			/**
+			 * \brief Destructor destroys any items left in the ring.
+			 */
+			~ring_store();
+			
+			/**
+			 * \brief Try to push an item into the ring.
+			 * 
+			 * \note Threadsafe, lock-free.
+			 * 
+			 * \returns False if the ring is full, in which case the item is untouched.
+			 */
+			bool push(buffer_item&& item);
+			
+			/**
+			 * \brief Move up to maxItems published items within the ring onto the back of
+			 * out, or every one if maxItems is zero.
+			 * 
+			 * \note Threadsafe with respect to producers, but there must only be one
+			 * consumer.
+			 */
+			std::size_t pop(std::vector<buffer_item>& out, const std::size_t maxItems);
+			
+			/**
+			 * \brief Producers cannot remove items from the ring, so this always returns
+			 * false.
+			 */
+			bool drop_front(std::size_t& itemBytes);
+			
+			/**
+			 * \brief Return the number of slots in the ring.
+			 */
+			inline std::size_t capacity() const {
+				return mask + 1;
+			}
+			
+			/**
+			 * \brief Round a value up to the next power of two.
+			 * 
+			 * \throws If value is zero we throw an invalid_argument.
+			 */
+			static std::size_t round_up(const std::size_t value);
+		
+		 private:
+			/**
+			 * \brief A slot within the ring.
+			 * 
+			 * The item is constructed in place when published and destroyed when
+			 * consumed, so empty slots do not hold a buffer_item.
+			 */
+			struct slot {
+				/**
+				 * \brief The lap of the ring this slot is ready for.
+				 */
+				std::atomic<std::size_t> sequence;
+				
+				/**
+				 * \brief Raw storage for the item.
+				 */
+				std::aligned_storage<sizeof(buffer_item),
+						alignof(buffer_item)>::type storage;
+			};
+			
+			/**
+			 * \brief Return the item stored within a slot.
+			 */
+			static inline buffer_item& item_in(slot& s) {
+				return *reinterpret_cast<buffer_item*>(&s.storage);
+			}
+			
+			/**
+			 * \brief The ring of slots.
+			 */
+			slot* const slots;
+			
+			/**
+			 * \brief The number of slots minus one, used to wrap indices.
+			 */
+			const std::size_t mask;
+			
+			/**
+			 * \brief Padding so producers do not false share with the members above.
+			 */
+			char padding0[AF_CACHE_LINE];
+			
+			/**
+			 * \brief The next position a producer will claim.
+			 */
+			std::atomic<std::size_t> enqueuePos;
+			
+			/**
+			 * \brief Padding so producers do not false share with the consumer.
+			 */
+			char padding1[AF_CACHE_LINE];
+			
+			/**
+			 * \brief The next position the consumer will read.
+			 * 
+			 * Only the consumer touches this so it needs no synchronization.
+			 */
+			std::size_t dequeuePos;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,283 @@
+#include "sharded_store.hpp"
+#include "ring_store.hpp"
+#include <algorithm>
+
+namespace buffer {
+	namespace store {
+		namespace {
+			/**
+			 * \brief Numbers the sharded stores created by the process.
+			 */
+			std::atomic<std::size_t> storeCounter(0);
+		}
+		
+		thread_local sharded_store::lease_list sharded_store::threadLeases;
+		
+		sharded_store::shard::shard()
+				: slots(0),
+				leased(false),
+				padding0{0},
+				tail(0),
+				padding1{0},
+				head(0),
+				padding2{0} {
+		}
+		
+		sharded_store::shard::~shard() {
+			delete[] slots;
+		}
+		
+		sharded_store::shard_set::shard_set(const std::size_t shardCount,
+				const std::size_t capacity)
+				: shards(new shard[shardCount]),
+				count(shardCount),
+				mask(ring_store::round_up(capacity) - 1) {
+			for(std::size_t i = 0; i < count; i++) {
+				shards[i].slots = new slot[mask + 1];
+			}
+		}
+		
+		sharded_store::lease_list::~lease_list() {
+			for(auto& held : leases) {
+				auto heldSet = held.set.lock();
+				if(heldSet && held.index < heldSet->count) {
+					heldSet->shards[held.index].leased.store(false,
+							std::memory_order_release);
+				}
+			}
+		}
+		
+		sharded_store::sharded_store(const std::size_t shardCount,
+				const std::size_t capacity,
+				const bool sequenced)
+				: storeId(storeCounter.fetch_add(1)),
+				sequenced(sequenced),
+				set(make_set(shardCount, capacity)),
+				nextSequence(0),
+				expectedSequence(0),
+				drainStart(0),
+				overflowHead(0),
+				overflowCount(0) {
+		}
+		
+		sharded_store::~sharded_store() {
+			std::vector<buffer_item> leftover;
+			
+			// Sequenced draining stops at gaps, which cannot close any more
+			for(std::size_t i = 0; i < set->count; i++) {
+				pop_shard(set->shards[i], leftover, 0);
+			}
+		}
+		
+		bool sharded_store::push(buffer_item&& item) {
+			const auto index = local_shard();
+			
+			if(UNLIKELY(index == set->count)) {
+				lock_t lock(overflowMutex);
+				
+				const auto sequence = sequenced ?
+						nextSequence.fetch_add(1, std::memory_order_relaxed) : 0;
+				overflow.emplace_back(sequence, std::move(item));
+				overflowCount.fetch_add(1, std::memory_order_release);
+				
+				return true;
+			}
+			
+			auto& target = set->shards[index];
+			const auto tail = target.tail.load(std::memory_order_relaxed);
+			
+			if(tail - target.head.load(std::memory_order_acquire) > set->mask) {
+				// The consumer has not caught up
+				return false;
+			}
+			
+			// The sequence is only taken once the item is sure to be published, so the
+			// consumer never waits on a number that will not come
+			auto& s = target.slots[tail & set->mask];
+			if(sequenced) {
+				s.sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+			}
+			new (&s.storage) buffer_item(std::move(item));
+			
+			// Publish to the consumer
+			target.tail.store(tail + 1, std::memory_order_release);
+			
+			return true;
+		}
+		
+		std::size_t sharded_store::pop(std::vector<buffer_item>& out,
+				const std::size_t maxItems) {
+			if(sequenced) {
+				return pop_sequenced(out, maxItems);
+			}
+			
+			const auto before = out.size();
+			std::size_t result = 0;
+			
+			for(std::size_t i = 0; i < set->count; i++) {
+				const auto taken = out.size() - before;
+				if(maxItems != 0 && taken == maxItems) {
+					break;
+				}
+				
+				result += pop_shard(set->shards[(drainStart + i) % set->count],
+						out,
+						maxItems == 0 ? 0 : maxItems - taken);
+			}
+			
+			// The next drain starts at the next shard so none is always last
+			drainStart = (drainStart + 1) % set->count;
+			
+			const auto taken = out.size() - before;
+			if(overflowCount.load(std::memory_order_acquire) != 0 &&
+					(maxItems == 0 || taken < maxItems)) {
+				result += pop_overflow(out, maxItems == 0 ? 0 : maxItems - taken);
+			}
+			
+			return result;
+		}
+		
+		std::shared_ptr<sharded_store::shard_set> sharded_store::make_set(
+				const std::size_t shardCount,
+				const std::size_t capacity) {
+			if(UNLIKELY(shardCount == 0)) {
+				throw std::invalid_argument(err_msg::_zrlngth);
+			}
+			
+			return std::make_shared<shard_set>(shardCount, capacity);
+		}
+		
+		bool sharded_store::drop_front(std::size_t&) {
+			// Only the consumer may advance the head of a shard
+			return false;
+		}
+		
+		std::size_t sharded_store::local_shard() {
+			auto& leases = threadLeases.leases;
+			
+			for(const auto& held : leases) {
+				if(held.storeId == storeId) {
+					return held.index;
+				}
+			}
+			
+			// Forget leases of stores that are gone
+			leases.erase(std::remove_if(leases.begin(), leases.end(), [] (const lease& held) {
+						return held.set.expired();
+					}),
+					leases.end());
+			
+			lease acquired;
+			acquired.set = set;
+			acquired.storeId = storeId;
+			acquired.index = set->count;
+			
+			for(std::size_t i = 0; i < set->count; i++) {
+				bool expected = false;
+				if(set->shards[i].leased.compare_exchange_strong(expected,
+						true,
+						std::memory_order_acquire)) {
+					acquired.index = i;
+					break;
+				}
+			}
+			
+			leases.push_back(acquired);
+			
+			return acquired.index;
+		}
+		
+		std::size_t sharded_store::pop_shard(shard& source,
+				std::vector<buffer_item>& out,
+				const std::size_t maxItems) {
+			auto head = source.head.load(std::memory_order_relaxed);
+			const auto tail = source.tail.load(std::memory_order_acquire);
+			std::size_t result = 0;
+			
+			for(std::size_t taken = 0;
+					head != tail && (maxItems == 0 || taken < maxItems);
+					taken++) {
+				auto& item = item_in(source.slots[head & set->mask]);
+				result += item.size();
+				out.push_back(std::move(item));
+				item.~buffer_item();
+				head++;
+			}
+			
+			// Free the slots for the producer
+			source.head.store(head, std::memory_order_release);
+			
+			return result;
+		}
+		
+		std::size_t sharded_store::pop_overflow(std::vector<buffer_item>& out,
+				const std::size_t maxItems) {
+			lock_t lock(overflowMutex);
+			
+			const auto available = overflow.size() - overflowHead;
+			const auto taken = (maxItems == 0 || maxItems > available) ?
+					available : maxItems;
+			std::size_t result = 0;
+			
+			for(std::size_t i = overflowHead; i < overflowHead + taken; i++) {
+				result += overflow[i].second.size();
+				out.push_back(std::move(overflow[i].second));
+			}
+			
+			overflowHead += taken;
+			overflowCount.fetch_sub(taken, std::memory_order_relaxed);
+			
+			if(overflowHead == overflow.size()) {
+				overflow.clear();
+				overflowHead = 0;
+			}
+			
+			return result;
+		}
+		
+		std::size_t sharded_store::pop_sequenced(std::vector<buffer_item>& out,
+				const std::size_t maxItems) {
+			std::size_t result = 0;
+			
+			for(std::size_t taken = 0; maxItems == 0 || taken < maxItems; taken++) {
+				// Find the head carrying the next number, every shard head is the lowest
+				// number within its shard
+				bool found = false;
+				
+				for(std::size_t i = 0; i < set->count && !found; i++) {
+					auto& source = set->shards[i];
+					const auto head = source.head.load(std::memory_order_relaxed);
+					
+					if(head != source.tail.load(std::memory_order_acquire) &&
+							source.slots[head & set->mask].sequence == expectedSequence) {
+						result += pop_shard(source, out, 1);
+						found = true;
+					}
+				}
+				
+				if(!found && overflowCount.load(std::memory_order_acquire) != 0) {
+					{
+						// Only the consumer removes items, so the front stays put once
+						// the lock is released
+						lock_t lock(overflowMutex);
+						found = overflowHead != overflow.size() &&
+								overflow[overflowHead].first == expectedSequence;
+					}
+					
+					if(found) {
+						result += pop_overflow(out, 1);
+					}
+				}
+				
+				if(!found) {
+					// Either drained or the next number is not yet published
+					break;
+				}
+				
+				expectedSequence++;
+			}
+			
+			return result;
+		}
+	}
+}
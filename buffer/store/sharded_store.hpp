@@ -0,0 +1,318 @@
+#ifndef _BUFFER_STORE_SHARDED_STORE_HPP
+#define _BUFFER_STORE_SHARDED_STORE_HPP
+
+#include <common.hpp>
+#include "../istore.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace buffer {
+	namespace store {
+		/**
+		 * \brief A store made of single-producer/single-consumer rings, one leased to
+		 * each producer thread.
+		 * 
+		 * A producer thread leases a shard on its first push and keeps it until the
+		 * thread exits, so producers never contend with each other and only share a
+		 * shard with the consumer. Producers beyond the number of shards fall back to a
+		 * mutex protected overflow queue.
+		 * 
+		 * Items of one producer always come out in the order they were pushed. Across
+		 * producers the consumer either takes from each shard in turn, or, when
+		 * sequenced, stamps every item from a global counter and merges the shards back
+		 * into exactly the order items were pushed in.
+		 */
+		class sharded_store : public ::buffer::istore {
+		 private:
+			/**
+			 * \brief Standard mutex lock type for the class.
+			 */
+			using lock_t = std::lock_guard<std::mutex>;
+		
+		 public:
+			/**
+			 * \brief Constructor takes the number of shards and the number of slots in
+			 * each.
+			 * 
+			 * The capacity is rounded up to the next power of two.
+			 * 
+			 * \throws If either count is zero we throw an invalid_argument.
+			 */
+			sharded_store(const std::size_t shardCount,
+					const std::size_t capacity,
+					const bool sequenced);
+			
+			/**
+			 * \brief Destructor destroys any items left in the store.
+			 */
+			~sharded_store();
+			
+			/**
+			 * \brief Try to push an item into the shard of the calling thread.
+			 * 
+			 * \note Threadsafe, lock-free once the thread holds a shard.
+			 * 
+			 * \returns False if the shard is full, in which case the item is untouched.
+			 */
+			bool push(buffer_item&& item);
+			
+			/**
+			 * \brief Move up to maxItems items onto the back of out, or every one if
+			 * maxItems is zero.
+			 * 
+			 * \note Threadsafe with respect to producers, but there must only be one
+			 * consumer.
+			 */
+			std::size_t pop(std::vector<buffer_item>& out, const std::size_t maxItems);
+			
+			/**
+			 * \brief Producers cannot remove items from a shard, so this always returns
+			 * false.
+			 */
+			bool drop_front(std::size_t& itemBytes);
+		
+		 private:
+			/**
+			 * \brief A slot within a shard.
+			 */
+			struct slot {
+			 public:
+				/**
+				 * \brief The global push order of the item, when sequenced.
+				 */
+				std::uint64_t sequence;
+				
+				/**
+				 * \brief Raw storage for the item.
+				 */
+				std::aligned_storage<sizeof(buffer_item),
+						alignof(buffer_item)>::type storage;
+			};
+			
+			/**
+			 * \brief A single-producer/single-consumer ring.
+			 */
+			struct shard {
+			 public:
+				/**
+				 * \brief Constructor.
+				 */
+				shard();
+				
+				/**
+				 * \brief Destructor.
+				 */
+				~shard();
+				
+				/**
+				 * \brief The ring of slots.
+				 */
+				slot* slots;
+				
+				/**
+				 * \brief Whether or not a producer thread holds the shard.
+				 */
+				std::atomic_bool leased;
+				
+				/**
+				 * \brief Padding so the producer does not false share with the consumer.
+				 */
+				char padding0[AF_CACHE_LINE];
+				
+				/**
+				 * \brief The next position the producer writes.
+				 */
+				std::atomic<std::size_t> tail;
+				
+				/**
+				 * \brief Padding so the producer does not false share with the consumer.
+				 */
+				char padding1[AF_CACHE_LINE];
+				
+				/**
+				 * \brief The next position the consumer reads.
+				 */
+				std::atomic<std::size_t> head;
+				
+				/**
+				 * \brief Padding so the consumer does not false share with the next shard.
+				 */
+				char padding2[AF_CACHE_LINE];
+			};
+			
+			/**
+			 * \brief The shards, shared with the leases of producer threads so a lease
+			 * can be given back after the store is gone.
+			 */
+			struct shard_set {
+			 public:
+				/**
+				 * \brief Constructor.
+				 */
+				shard_set(const std::size_t shardCount, const std::size_t capacity);
+				
+				/**
+				 * \brief The shards.
+				 */
+				std::unique_ptr<shard[]> shards;
+				
+				/**
+				 * \brief The number of shards.
+				 */
+				const std::size_t count;
+				
+				/**
+				 * \brief The number of slots in a shard minus one, used to wrap indices.
+				 */
+				const std::size_t mask;
+			};
+			
+			/**
+			 * \brief A shard leased by a thread.
+			 */
+			struct lease {
+			 public:
+				/**
+				 * \brief The set the shard is in.
+				 */
+				std::weak_ptr<shard_set> set;
+				
+				/**
+				 * \brief The store the set belongs to.
+				 */
+				std::size_t storeId;
+				
+				/**
+				 * \brief The index of the shard, or the shard count if the thread uses
+				 * the overflow queue.
+				 */
+				std::size_t index;
+			};
+			
+			/**
+			 * \brief The leases held by a thread, given back at thread exit.
+			 */
+			struct lease_list {
+			 public:
+				/**
+				 * \brief Destructor gives back every lease of a store still alive.
+				 */
+				~lease_list();
+				
+				/**
+				 * \brief The leases, usually one per store the thread pushes to.
+				 */
+				std::vector<lease> leases;
+			};
+			
+			/**
+			 * \brief The leases of the calling thread.
+			 */
+			static thread_local lease_list threadLeases;
+			
+			/**
+			 * \brief Uniquely identifies the store to thread leases.
+			 */
+			const std::size_t storeId;
+			
+			/**
+			 * \brief Whether or not items are stamped and merged in push order.
+			 */
+			const bool sequenced;
+			
+			/**
+			 * \brief The shards.
+			 */
+			const std::shared_ptr<shard_set> set;
+			
+			/**
+			 * \brief The next sequence number, when sequenced.
+			 */
+			std::atomic<std::uint64_t> nextSequence;
+			
+			/**
+			 * \brief The sequence number the consumer emits next, when sequenced.
+			 */
+			std::uint64_t expectedSequence;
+			
+			/**
+			 * \brief The shard a round robin drain starts at.
+			 */
+			std::size_t drainStart;
+			
+			/**
+			 * \brief Items of producers that could not lease a shard.
+			 */
+			std::vector<std::pair<std::uint64_t, buffer_item>> overflow;
+			
+			/**
+			 * \brief The index into overflow of the next item to read.
+			 */
+			std::size_t overflowHead;
+			
+			/**
+			 * \brief The number of items in the overflow queue.
+			 */
+			std::atomic<std::size_t> overflowCount;
+			
+			/**
+			 * \brief Mutex protector of the overflow queue.
+			 */
+			std::mutex overflowMutex;
+			
+			/**
+			 * \brief Create the shards.
+			 * 
+			 * \throws If either count is zero we throw an invalid_argument.
+			 */
+			static std::shared_ptr<shard_set> make_set(const std::size_t shardCount,
+					const std::size_t capacity);
+			
+			/**
+			 * \brief Return the index of the shard leased to the calling thread, leasing
+			 * one if needed, or the shard count if none is free.
+			 */
+			std::size_t local_shard();
+			
+			/**
+			 * \brief Move up to maxItems items, or all if zero, from a shard onto out.
+			 * 
+			 * \returns The total size of the data of the moved items.
+			 */
+			std::size_t pop_shard(shard& source,
+					std::vector<buffer_item>& out,
+					const std::size_t maxItems);
+			
+			/**
+			 * \brief Move up to maxItems items, or all if zero, from the overflow queue
+			 * onto out.
+			 * 
+			 * \returns The total size of the data of the moved items.
+			 */
+			std::size_t pop_overflow(std::vector<buffer_item>& out,
+					const std::size_t maxItems);
+			
+			/**
+			 * \brief Move items onto out strictly in sequence until maxItems, if not
+			 * zero, are moved or the next item in sequence is not yet visible.
+			 * 
+			 * \returns The total size of the data of the moved items.
+			 */
+			std::size_t pop_sequenced(std::vector<buffer_item>& out,
+					const std::size_t maxItems);
+			
+			/**
+			 * \brief Return the item stored within a slot.
+			 */
+			static inline buffer_item& item_in(slot& s) {
+				return *reinterpret_cast<buffer_item*>(&s.storage);
+			}
+		};
+	}
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <stdexcept>
+#include <cstdint>
 #include <cstdlib>
 #include "net/global_zcontext.hpp"
 #include <iostream>
@@ -34,6 +35,22 @@
 #	define UNLIKELY(x)	(x)
 #endif
 
+/**
+ * \brief Hint to the CPU that the thread is spinning, which eases the pipeline and
+ * the sibling hyperthread.
+ * 
+ * This is only a compiler barrier where there is no such instruction.
+ */
+#if (defined __GNUC__ || defined __clang__) && (defined __x86_64__ || defined __i386__)
+#	define CPU_RELAX()	__builtin_ia32_pause()
+#elif (defined __GNUC__ || defined __clang__) && defined __aarch64__
+#	define CPU_RELAX()	__asm__ __volatile__("yield" ::: "memory")
+#elif defined __GNUC__ || defined __clang__
+#	define CPU_RELAX()	__asm__ __volatile__("" ::: "memory")
+#else
+#	define CPU_RELAX()
+#endif
+
 /**
  * \brief Used to supress compiler warnings about unused variables.
  */
@@ -81,6 +98,13 @@
 #	define AF_QUINTN uint8_t
 #endif
 
+/**
+ * \brief The assumed size of a cache line in bytes.
+ * 
+ * Used to pad apart data that is written by different threads.
+ */
+#define AF_CACHE_LINE 64
+
 /**
  * \brief Error message strings.
  */
@@ -94,6 +118,11 @@ namespace err_msg {
 	const char _zrlngth[] = "zero length";
 	const char _ntwrkdn[] = "network down";
 	const char _unrchcd[] = "unreachable code reached";
+	const char _rsrcbsy[] = "resource busy";
+	const char _unsprtd[] = "unsupported combination";
+	const char _fdunavl[] = "file descriptor unavailable";
+	const char _ovrldd[] = "overloaded";
+	const char _dlnexpd[] = "deadline expired";
 	
 	
 	const char _malinpt[] = "malformed input";
@@ -112,5 +141,34 @@ namespace err_msg {
 
 #define ARRAY_COUNT(x) sizeof(x)/sizeof(x[0])
 
+/**
+ * \brief FNV-1a hash of a cstring, for use in constant expressions such as case
+ * labels.
+ * 
+ * Two equal case labels within a switch fail to compile, so a switch over hashes is
+ * checked to be collision free when it is built.
+ * 
+ * \warning This recurses per character, so use str_hash() on runtime strings.
+ */
+constexpr std::uint32_t ct_str_hash(const char* const str,
+		const std::uint32_t hash = 2166136261u) {
+	return *str == '\0' ?
+			hash :
+			ct_str_hash(str + 1, (hash ^ static_cast<std::uint8_t>(*str)) * 16777619u);
+}
+
+/**
+ * \brief FNV-1a hash of a cstring, equal to ct_str_hash() of the same string.
+ */
+inline std::uint32_t str_hash(const char* str) {
+	std::uint32_t hash = 2166136261u;
+	
+	for(; *str != '\0'; str++) {
+		hash = (hash ^ static_cast<std::uint8_t>(*str)) * 16777619u;
+	}
+	
+	return hash;
+}
+
 
 #endif
@@ -1,4 +1,7 @@
 #include "brazil.hpp"
+#include <boost/bind.hpp>
+#include <boost/program_options.hpp>
+#include <boost/tokenizer.hpp>
 
 namespace module {
 	namespace brazil {
@@ -16,7 +19,74 @@ namespace module {
 		}
 		
 		void brazil::string_initialize_parameters(const char* const parameters) {
-			UNUSED(parameters);
+			::buffer::queue_buffer::config bufferConfig;
+			std::string bufferStore("locked");
+			std::string bufferOverflow("block");
+			std::string bufferShardOrder("round_robin");
+			
+			try {
+				// Tokenize string
+				std::string tparameters(parameters);
+				boost::escaped_list_separator<char> seperator("\\", "= ", "\"\'");
+				boost::tokenizer<boost::escaped_list_separator<char>> tokens(tparameters, seperator);
+				std::vector<std::string> tokenStrings;
+				std::copy_if(tokens.begin(), tokens.end(), std::back_inserter(tokenStrings), !boost::bind(&std::string::empty, _1));
+				
+				namespace po = boost::program_options;
+				
+				po::options_description desc("Options");
+				desc.add_options()
+					("buffer", po::value<std::string>(&bufferStore), "async buffer store [locked|ring|sharded]")
+					("bufferCapacity", po::value<std::size_t>(&bufferConfig.capacity), "async buffer ring slots")
+					("bufferShards", po::value<std::size_t>(&bufferConfig.shards), "async buffer shards")
+					("bufferShardOrder", po::value<std::string>(&bufferShardOrder), "async buffer shard order [round_robin|sequenced]")
+					("bufferMaxItems", po::value<std::size_t>(&bufferConfig.maxItems), "async buffer item limit, 0 for none")
+					("bufferMaxBytes", po::value<std::size_t>(&bufferConfig.maxBytes), "async buffer byte limit, 0 for none")
+					("bufferOverflow", po::value<std::string>(&bufferOverflow), "async buffer overflow policy [block|drop_oldest|drop_newest|spill]")
+					("bufferLanes", po::value<std::size_t>(&bufferConfig.lanes), "async buffer priority lanes")
+					("bufferStarvationLimit", po::value<std::size_t>(&bufferConfig.starvationLimit), "async buffer drains a lower lane may be passed over")
+					("bufferSpillDir", po::value<std::string>(&bufferConfig.spillDirectory), "async buffer spill journal directory")
+					("bufferSpillSegment", po::value<std::size_t>(&bufferConfig.spillSegmentSize), "async buffer spill journal segment bytes");
+				
+				po::variables_map vm;
+				po::store(po::command_line_parser(tokenStrings).options(desc).run(), vm);
+				po::notify(vm);
+			} catch(boost::program_options::error &e) {
+				std::cerr << e.what() << std::endl;
+				exit(-1);
+			}
+			
+			if(bufferStore == "locked") {
+				bufferConfig.store = ::buffer::queue_buffer::store_type::locked;
+			} else if(bufferStore == "ring") {
+				bufferConfig.store = ::buffer::queue_buffer::store_type::ring;
+			} else if(bufferStore == "sharded") {
+				bufferConfig.store = ::buffer::queue_buffer::store_type::sharded;
+			} else {
+				throw std::invalid_argument(err_msg::_malinpt);
+			}
+			
+			if(bufferShardOrder == "round_robin") {
+				bufferConfig.shardOrder = ::buffer::queue_buffer::shard_order::round_robin;
+			} else if(bufferShardOrder == "sequenced") {
+				bufferConfig.shardOrder = ::buffer::queue_buffer::shard_order::sequenced;
+			} else {
+				throw std::invalid_argument(err_msg::_malinpt);
+			}
+			
+			if(bufferOverflow == "block") {
+				bufferConfig.overflow = ::buffer::queue_buffer::overflow_policy::block;
+			} else if(bufferOverflow == "drop_oldest") {
+				bufferConfig.overflow = ::buffer::queue_buffer::overflow_policy::drop_oldest;
+			} else if(bufferOverflow == "drop_newest") {
+				bufferConfig.overflow = ::buffer::queue_buffer::overflow_policy::drop_newest;
+			} else if(bufferOverflow == "spill") {
+				bufferConfig.overflow = ::buffer::queue_buffer::overflow_policy::spill;
+			} else {
+				throw std::invalid_argument(err_msg::_malinpt);
+			}
+			
+			configure_async_buffer(bufferConfig);
 		}
 		
 		::module::imodule::response* brazil::proc_act_request(
@@ -3,6 +3,7 @@
 
 #include <common.hpp>
 #include <module/iproc_unit.hpp>
+#include <module/method_table.hpp>
 #include <net/server.hpp>
 #include <net/tcp_client.hpp>
 #include <arpa/inet.h>
@@ -118,18 +119,7 @@ namespace module {
 			 * \note Threadsafe.
 			 */
 			bool proc_act_push(const request& request) {
-				const auto method = request.method();
-				
-				if(strcmp(method, "tx") == 0) {
-					auto rIP = request.parameter<unsigned int>(0);
-					auto rPort = request.parameter<unsigned short>(1);
-					auto rData = request.parameter<const char*>(2);
-					auto rDataLen = request.parameter_str_size(2);
-
-					return transmit(rIP, rPort, rData, rDataLen);
-				} else {
-					throw std::runtime_error(err_msg::_malinpt);
-				}
+				return pushMethods.call(*this, request);
 			}
 		
 		 protected:
@@ -189,7 +179,9 @@ namespace module {
 			 * \brief Transmit a data buffer and return whether the transmission was
 			 * successful.
 			 * 
-			 * \note The implementation of this must be threadsafe.
+			 * Transmissions are serialized by the transmitMutex, as each one opens and
+			 * closes a connection whose requests toggle the receiving state of the peer,
+			 * so an implementation need not guard against another transmission.
 			 */
 			virtual bool transmit(const unsigned long ip,
 					const unsigned short port,
@@ -261,8 +253,24 @@ namespace module {
 			 * \warning Use the requestMutex with this.
 			 */
 			std::condition_variable hasReceivedCV;
+			
+			/**
+			 * \brief Mutex held for a whole transmission, so concurrent pushes cannot
+			 * interleave their connections.
+			 */
+			std::mutex transmitMutex;
 		
 		// private:
+			/**
+			 * \brief Alias declaration type of the table of push methods.
+			 */
+			using push_table_t = ::module::method_table<itrx_proc_unit, bool>;
+			
+			/**
+			 * \brief The push methods of a transceiver.
+			 */
+			static const push_table_t pushMethods;
+			
 			/**
 			 * \brief The network information for accepting communication requests.
 			 */
@@ -327,7 +335,26 @@ namespace module {
 				}
 				isReceiving = !isReceiving;
 			}
+			
+			/**
+			 * \brief Handler of the tx push method, which transmits a buffer of data.
+			 */
+			static bool push_tx(itrx_proc_unit& unit, const request& request) {
+				auto rIP = request.parameter<unsigned int>(0);
+				auto rPort = request.parameter<unsigned short>(1);
+				auto rData = request.parameter<const char*>(2);
+				auto rDataLen = request.parameter_str_size(2);
+				
+				lock_t lock(unit.transmitMutex);
+				
+				return unit.transmit(rIP, rPort, rData, rDataLen);
+			}
 		};
+		
+		template <typename T> const typename itrx_proc_unit<T>::push_table_t
+				itrx_proc_unit<T>::pushMethods({
+			{"tx", &itrx_proc_unit<T>::push_tx, false}
+		});
 	}
 }
 
@@ -10,6 +10,10 @@
 namespace module {
 	namespace brazil {
 		namespace proc_unit {
+			const bobwire_circuit::request_table_t bobwire_circuit::requestMethods({
+				{"configure_detector", &bobwire_circuit::request_configure_detector, false}
+			});
+			
 			bobwire_circuit::bobwire_circuit()
 					: dispatcher(NULL),
 					socket(::net::global_zcontext, ZMQ_SUB),
@@ -141,7 +145,7 @@ namespace module {
 							.add<const char*, false>("chexp")
 							.add<const char*, false>(circuit.c_str())
 							.add<const char*, false>("\n");
-					::net::simulation::response response(dispatcher->call(request));
+					::net::simulation::response response(call_dispatcher(request));
 					
 					close_connection(std::move(connection));
 					
@@ -154,6 +158,13 @@ namespace module {
 				return true;
 			}
 			
+			::net::simulation::response bobwire_circuit::call_dispatcher(
+					::net::simulation::request& request) {
+				lock_t lock(dispatcherMutex);
+				
+				return dispatcher->call(request);
+			}
+			
 			void bobwire_circuit::async_work(::buffer::queue_buffer& out) {
 					::zmq::message_t msg;
 					if(socket.recv(&msg)) {
@@ -167,10 +178,10 @@ namespace module {
 						// Receive our actual data
 						socket.recv(&msg);
 						
+						// Hand the message over without copying its data
 						out.push(
 								::buffer::buffer_item(
-									(char*)msg.data(),
-									msg.size(),
+									std::move(msg),
 									0,
 									0,
 									false)
@@ -185,17 +196,18 @@ namespace module {
 			
 			::module::iproc_unit::response* bobwire_circuit::proc_act_request(
 						const ::module::iproc_unit::request& request) {
-				const auto method = request.method();
+				return requestMethods.call(*this, request);
+			}
+			
+			::module::iproc_unit::response* bobwire_circuit::request_configure_detector(
+					bobwire_circuit& unit,
+					const ::module::iproc_unit::request& request) {
+				UNUSED(unit);
+				UNUSED(request);
 				
-				if(strcmp(method, "configure_detector") == 0) {
-					throw std::logic_error("unimplemented");
-					
-					
-					/** \todo: return a value here */
-					
-				} else {
-					throw std::logic_error(err_msg::_unrchcd);
-				}
+				throw std::logic_error("unimplemented");
+				
+				/** \todo: return a value here */
 			}
 		}
 	}
@@ -66,11 +66,43 @@ namespace module {
 						const std::size_t len);
 			
 			 private:
+				/**
+				 * \brief Alias declaration type of the table of request methods.
+				 */
+				using request_table_t = ::module::method_table<bobwire_circuit,
+						::module::iproc_unit::response*>;
+				
+				/**
+				 * \brief The request methods of the circuit.
+				 */
+				static const request_table_t requestMethods;
+				
+				/**
+				 * \brief Handler of the configure_detector request method.
+				 */
+				static ::module::iproc_unit::response* request_configure_detector(
+						bobwire_circuit& unit,
+						const ::module::iproc_unit::request& request);
+				
+				/**
+				 * \brief Send a request to the dispatcher.
+				 * 
+				 * \note Threadsafe.
+				 */
+				::net::simulation::response call_dispatcher(
+						::net::simulation::request& request);
+				
 				/**
 				 * \brief Connection to network dispatcher for tx.
 				 */
 				::net::simulation::client* dispatcher;
 				
+				/**
+				 * \brief Mutex protector of the dispatcher connection, which is not
+				 * threadsafe.
+				 */
+				std::mutex dispatcherMutex;
+				
 				/**
 				 * \brief Connection to network dispatcher for rx.
 				 */
@@ -178,7 +210,7 @@ namespace module {
 								.add<const char*, false>("chpext")
 								.add<const char*, false>(basisChange.c_str())
 								.add<const char*, false>("\n");
-						dispatcher->call(rqst);
+						call_dispatcher(rqst);
 					}
 					isReceiving = !isReceiving;
 				}
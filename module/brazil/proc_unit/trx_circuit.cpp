@@ -9,6 +9,10 @@
 namespace module {
 	namespace brazil {
 		namespace proc_unit {
+			const trx_circuit::request_table_t trx_circuit::requestMethods({
+				{"configure_detector", &trx_circuit::request_configure_detector, false}
+			});
+			
 			trx_circuit::trx_circuit()
 					: dispatcher(NULL),
 					socket(::net::global_zcontext, ZMQ_SUB),
@@ -142,7 +146,7 @@ namespace module {
 							.add<const char*, false>(TRX_CIRCUIT_LANGUAGE)
 							.add<const char*, false>(circuit.c_str())
 							.add<const char*, false>(TRX_CIRCUIT_NEWLINE_DELIMITER);
-					::net::simulation::response response(dispatcher->call(request));
+					::net::simulation::response response(call_dispatcher(request));
 					
 					close_connection(std::move(connection));
 					
@@ -155,6 +159,13 @@ namespace module {
 				return true;
 			}
 			
+			::net::simulation::response trx_circuit::call_dispatcher(
+					::net::simulation::request& request) {
+				lock_t lock(dispatcherMutex);
+				
+				return dispatcher->call(request);
+			}
+			
 			void trx_circuit::async_work(::buffer::queue_buffer& out) {
 					::zmq::message_t msg;
 					if(socket.recv(&msg)) {
@@ -167,10 +178,10 @@ namespace module {
 						
 						// Receive our actual data
 						socket.recv(&msg);
+						// Hand the message over without copying its data
 						out.push(
 								::buffer::buffer_item(
-									(char*)msg.data(),
-									msg.size(),
+									std::move(msg),
 									0,
 									0,
 									false)
@@ -186,22 +197,24 @@ namespace module {
 			// should this really be this action type?
 			::module::iproc_unit::response* trx_circuit::proc_act_request(
 						const ::module::iproc_unit::request& request) {
-				const auto method = request.method();
+				return requestMethods.call(*this, request);
+			}
+			
+			::module::iproc_unit::response* trx_circuit::request_configure_detector(
+					trx_circuit& unit,
+					const ::module::iproc_unit::request& request) {
+				::net::simulation::request rqst("configure_node", false);
+				rqst.add<unsigned int>(unit.nIP)
+						.add<const char*, false>("receiver")
+						.add<const char*, false>(TRX_CIRCUIT_LANGUAGE)
+						.add<const char*, false>(TRX_CIRCUIT_MEASURE)
+						.add<const char*, false>(TRX_CIRCUIT_NEWLINE_DELIMITER);
+				const auto response = unit.call_dispatcher(rqst);
 				
-				if(strcmp(method, "configure_detector") == 0) {
-					::net::simulation::request rqst("configure_node", false);
-					rqst.add<unsigned int>(nIP)
-							.add<const char*, false>("receiver")
-							.add<const char*, false>(TRX_CIRCUIT_LANGUAGE)
-							.add<const char*, false>(TRX_CIRCUIT_MEASURE)
-							.add<const char*, false>(TRX_CIRCUIT_NEWLINE_DELIMITER);
-					dispatcher->call(rqst);
-					
-					/** \todo: return a value here */
-					
-				} else {
-					throw std::logic_error(err_msg::_unrchcd);
-				}
+				/** \todo: return a more useful value here */
+				return new ::module::iproc_unit::response(!response.get_error(),
+						false,
+						request.encoding());
 			}
 		}
 	}
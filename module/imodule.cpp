@@ -5,7 +5,8 @@ namespace module {
 			: supportedActions(supportedActions),
 			loadedProcUnit(NULL),
 			isRunning(false),
-			doExit(false) {
+			doExit(false),
+			asyncBuffer(new ::buffer::queue_buffer()) {
 	}
 	
 	imodule::~imodule() {
@@ -51,6 +52,21 @@ namespace module {
 		loadedProcUnit = NULL;
 	}
 	
+	void imodule::configure_async_buffer(
+			const ::buffer::queue_buffer::config& configuration) {
+		lock_t lock(stateMutex);
+		
+		if(UNLIKELY(loadedProcUnit != NULL)) {
+			throw std::logic_error(err_msg::_rsrcbsy);
+		}
+		
+		asyncBuffer.reset(new ::buffer::queue_buffer(configuration));
+	}
+	
+	bool imodule::is_idempotent(const char* const method) {
+		return loaded_proc_unit().is_idempotent(method);
+	}
+	
 	bool imodule::is_proc_unit_loaded() {
 		lock_t lock(stateMutex);
 		
@@ -83,7 +99,10 @@ namespace module {
 		if(isRunning) {
 			doExit = true;
 			
+			// A bounded buffer may hold the worker in a blocking push
+			asyncBuffer->interrupt();
 			asyncProcThread.join();
+			asyncBuffer->resume();
 			
 			doExit = false;
 			isRunning = false;
@@ -92,7 +111,7 @@ namespace module {
 	
 	void imodule::_async_proc_wrapper() {
 		while(!doExit) {
-			loadedProcUnit->async_work(asyncBuffer);
+			loadedProcUnit->async_work(*asyncBuffer);
 			
 			/** \todo */
 			//std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(5));
@@ -9,6 +9,7 @@
 #include <net/middleware/response.hpp>
 #include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <thread>
 
@@ -101,6 +102,16 @@ namespace module {
 		 */
 		virtual bool proc_act_push(const request& request) = 0;
 		
+		/**
+		 * \brief Return whether or not a request method is idempotent.
+		 * 
+		 * By default this asks the loaded processing unit. A module that answers some
+		 * methods itself should override this for those methods.
+		 * 
+		 * \warning The implementation of this function must be threadsafe.
+		 */
+		virtual bool is_idempotent(const char* const method);
+		
 		/**
 		 * \brief Load a processing unit by its name and with some parameters.
 		 * 
@@ -143,10 +154,22 @@ namespace module {
 		 * implemention of it.
 		 */
 		inline ::buffer::queue_buffer& async_buffer() {
-			return asyncBuffer;
+			return *asyncBuffer;
 		}
 	
 	 protected:
+		/**
+		 * \brief Replace the module's async buffer with one built from a configuration.
+		 * 
+		 * This is meant to be called while initializing the module, before anything
+		 * holds a reference to the buffer.
+		 * 
+		 * \note Threadsafe.
+		 * 
+		 * \throws If a processing unit is loaded we throw a logic_error.
+		 */
+		void configure_async_buffer(const ::buffer::queue_buffer::config& configuration);
+		
 		/**
 		 * \brief Register a module's processing units.
 		 */
@@ -199,7 +222,7 @@ namespace module {
 		/**
 	 	 * \brief The buffer of async items.
 	 	 */
-		::buffer::queue_buffer asyncBuffer;
+		std::unique_ptr<::buffer::queue_buffer> asyncBuffer;
 		
 		/**
 		 * \brief The thread that is running async action processing, if required.
@@ -10,4 +10,10 @@ namespace module {
 	iproc_unit* iproc_unit::initialize() {
 		throw std::runtime_error(err_msg::_stcimpl);
 	}
+	
+	bool iproc_unit::is_idempotent(const char* const method) const {
+		UNUSED(method);
+		
+		return false;
+	}
 }
@@ -99,6 +99,18 @@ namespace module {
 		 * \warning The implementation of this function must be threadsafe.
 		 */
 		virtual bool proc_act_push(const request& request) = 0;
+		
+		/**
+		 * \brief Return whether or not a request method is idempotent, i.e. whether its
+		 * response depends only on its parameters and on the pushes made before it.
+		 * 
+		 * Responses to idempotent methods may be cached by the module manager and
+		 * given again until the next push, so a method must not be marked as such if
+		 * what it reads can change in any other way. None are by default.
+		 * 
+		 * \warning The implementation of this function must be threadsafe.
+		 */
+		virtual bool is_idempotent(const char* const method) const;
 	};
 }
 
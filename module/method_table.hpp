@@ -0,0 +1,272 @@
+#ifndef _MODULE_METHOD_TABLE_HPP
+#define _MODULE_METHOD_TABLE_HPP
+
+#include <common.hpp>
+#include <module/iproc_unit.hpp>
+#include <cstring>
+#include <initializer_list>
+#include <type_traits>
+#include <vector>
+
+/**
+ * \brief The handler of a method table that unpacks the parameters of a request into
+ * the arguments of a member function and returns its result as is.
+ */
+#define MODULE_METHOD_UNPACKED(table, fn) &table::template unpacked<decltype(fn), fn>
+
+/**
+ * \brief The handler of a method table that unpacks the parameters of a request into
+ * the arguments of a member function and answers with its result.
+ */
+#define MODULE_METHOD_ANSWERED(table, fn) &table::template answered<decltype(fn), fn>
+
+namespace module {
+	/**
+	 * \brief A table routing the methods of a processing unit of type T to handlers
+	 * returning type R.
+	 * 
+	 * A processing unit lists its methods and their handlers once, and the table places
+	 * them in an open addressed hash table when it is built. Dispatch hashes the method
+	 * and compares it against the few methods sharing its slot, so the cost does not
+	 * grow with the number of methods.
+	 * 
+	 * A handler may be written by hand, or made from a member function by
+	 * MODULE_METHOD_UNPACKED or MODULE_METHOD_ANSWERED, which convert the parameters
+	 * of the request to the types of its arguments, in order.
+	 */
+	template <typename T, typename R> class method_table {
+	 public:
+		/**
+		 * \brief Alias declaration type of the request object supplied to handlers.
+		 */
+		using request = ::module::iproc_unit::request;
+		
+		/**
+		 * \brief Alias declaration type of the response object created by handlers.
+		 */
+		using response = ::module::iproc_unit::response;
+		
+		/**
+		 * \brief Alias declaration type of a handler of a method.
+		 */
+		using handler_t = R (*)(T&, const request&);
+		
+		/**
+		 * \brief A method and how it is handled.
+		 */
+		struct method {
+		 public:
+			/**
+			 * \brief The name of the method.
+			 */
+			const char* name;
+			
+			/**
+			 * \brief The handler of the method.
+			 */
+			handler_t handler;
+			
+			/**
+			 * \brief Whether or not the method is idempotent, so its responses may be
+			 * cached until the next push.
+			 */
+			bool idempotent;
+		};
+		
+		/**
+		 * \brief Constructor builds the table from a list of methods.
+		 * 
+		 * \throws If a method is listed twice we throw an invalid_argument.
+		 */
+		method_table(const std::initializer_list<method> methods)
+				: slots(round_up(methods.size() * 2)),
+				mask(slots.size() - 1) {
+			for(const auto& m : methods) {
+				const auto hash = str_hash(m.name);
+				auto i = hash & mask;
+				
+				for(; slots[i].name != NULL; i = (i + 1) & mask) {
+					if(UNLIKELY(std::strcmp(slots[i].name, m.name) == 0)) {
+						throw std::invalid_argument(err_msg::_rgstrfl);
+					}
+				}
+				
+				slots[i].hash = hash;
+				slots[i].name = m.name;
+				slots[i].handler = m.handler;
+				slots[i].idempotent = m.idempotent;
+			}
+		}
+		
+		/**
+		 * \brief Handle a request with the handler of its method.
+		 * 
+		 * \throws If the method is not in the table we throw a runtime_error.
+		 */
+		inline R call(T& unit, const request& rqst) const {
+			const auto found = find(rqst.method());
+			
+			if(UNLIKELY(found == NULL)) {
+				throw std::runtime_error(err_msg::_malinpt);
+			}
+			
+			return found->handler(unit, rqst);
+		}
+		
+		/**
+		 * \brief Return whether or not a method is in the table.
+		 */
+		inline bool contains(const char* const name) const {
+			return find(name) != NULL;
+		}
+		
+		/**
+		 * \brief Return whether or not a method is in the table and idempotent.
+		 */
+		inline bool is_idempotent(const char* const name) const {
+			const auto found = find(name);
+			
+			return found != NULL && found->idempotent;
+		}
+		
+		/**
+		 * \brief Handler calling a member function with the parameters of the request
+		 * and returning its result.
+		 */
+		template <typename F, F Fn> static R unpacked(T& unit, const request& rqst) {
+			return invoke(unit, Fn, rqst);
+		}
+		
+		/**
+		 * \brief Handler calling a member function with the parameters of the request
+		 * and answering with a response of its result, in the encoding of the request.
+		 */
+		template <typename F, F Fn> static R answered(T& unit, const request& rqst) {
+			return new response(invoke(unit, Fn, rqst), false, rqst.encoding());
+		}
+	
+	 private:
+		/**
+		 * \brief A slot of the hash table.
+		 */
+		struct slot {
+		 public:
+			/**
+			 * \brief Constructor of an empty slot.
+			 */
+			slot()
+					: hash(0),
+					name(NULL),
+					handler(NULL),
+					idempotent(false) {
+			}
+			
+			/**
+			 * \brief The hash of the name of the method.
+			 */
+			std::uint32_t hash;
+			
+			/**
+			 * \brief The name of the method, or NULL if the slot is empty.
+			 */
+			const char* name;
+			
+			/**
+			 * \brief The handler of the method.
+			 */
+			handler_t handler;
+			
+			/**
+			 * \brief Whether or not the method is idempotent.
+			 */
+			bool idempotent;
+		};
+		
+		/**
+		 * \brief A list of parameter indices.
+		 */
+		template <std::size_t... I> struct indices {
+		};
+		
+		/**
+		 * \brief Make the list of parameter indices 0 to N - 1.
+		 */
+		template <std::size_t N, std::size_t... I> struct make_indices
+				: make_indices<N - 1, N - 1, I...> {
+		};
+		
+		/**
+		 * \brief End of recursion for making a list of parameter indices.
+		 */
+		template <std::size_t... I> struct make_indices<0, I...> {
+			using type = indices<I...>;
+		};
+		
+		/**
+		 * \brief The slots of the hash table, a power of two of them.
+		 */
+		std::vector<slot> slots;
+		
+		/**
+		 * \brief The mask taking a hash to a slot index.
+		 */
+		const std::size_t mask;
+		
+		/**
+		 * \brief Return the slot of a method, or NULL if it is not in the table.
+		 * 
+		 * The table is at most half full, so probing ends at an empty slot soon.
+		 */
+		inline const slot* find(const char* const name) const {
+			const auto hash = str_hash(name);
+			
+			for(auto i = hash & mask; slots[i].name != NULL; i = (i + 1) & mask) {
+				if(slots[i].hash == hash && std::strcmp(slots[i].name, name) == 0) {
+					return &slots[i];
+				}
+			}
+			
+			return NULL;
+		}
+		
+		/**
+		 * \brief Call a member function with the parameters of the request converted to
+		 * the types of its arguments.
+		 */
+		template <typename U, typename C, typename... Args>
+				static inline U invoke(T& unit,
+					U (C::*fn)(Args...),
+					const request& rqst) {
+			return invoke(unit, fn, rqst, typename make_indices<sizeof...(Args)>::type());
+		}
+		
+		/**
+		 * \brief Call a member function with the parameters of the request by index.
+		 */
+		template <typename U, typename C, typename... Args, std::size_t... I>
+				static inline U invoke(T& unit,
+					U (C::*fn)(Args...),
+					const request& rqst,
+					indices<I...>) {
+			// Unused when the member function takes no arguments
+			UNUSED(rqst);
+			
+			return (unit.*fn)(
+					rqst.template parameter<typename std::decay<Args>::type>(I)...);
+		}
+		
+		/**
+		 * \brief Return the power of two at or above a number of slots.
+		 */
+		static inline std::size_t round_up(const std::size_t value) {
+			std::size_t result = 1;
+			while(result < value) {
+				result <<= 1;
+			}
+			
+			return result;
+		}
+	};
+}
+
+#endif
@@ -1,9 +1,13 @@
 #include "module_manager.hpp"
 
 namespace module {
+	const std::size_t module_manager::cache_max_entries;
+	
 	module_manager::module_manager()
 			: loadedModule(NULL),
-			serverCallback{NULL, NULL} {
+			serverCallback{NULL, NULL},
+			cacheGeneration(0),
+			expiredCount(0) {
 	}
 	
 	module_manager::~module_manager() {
@@ -31,6 +35,7 @@ namespace module {
 		}
 		
 		loadedModule->load_proc_unit(name, parameters);
+		invalidate_cache();
 		
 		#ifdef THROW
 		if(UNLIKELY(serverCallback.instance == NULL || serverCallback.callback == NULL)) {
@@ -52,6 +57,7 @@ namespace module {
 		loadedModule->unload_proc_unit();
 		delete loadedModule;
 		loadedModule = NULL;
+		invalidate_cache();
 	}
 	
 	void module_manager::unload_proc_unit() {
@@ -62,50 +68,178 @@ namespace module {
 		}
 		
 		loadedModule->unload_proc_unit();
+		invalidate_cache();
 	}
 	
 	imodule::response* module_manager::proc_act_request(
 			const imodule::request& request) {
-		lock_t lock(stateMutex);
+		shared_lock_t lock(stateMutex);
 		
 		#ifdef THROW
 		if(UNLIKELY(loadedModule == NULL || !loadedModule->is_proc_unit_loaded())) {
 			throw std::runtime_error(err_msg::_nllpntr);
 		}
 		#endif
-	
-		return loadedModule->proc_act_request(request);
+		
+		check_deadline(request);
+		
+		return request_cached(request);
 	}
 	
 	bool module_manager::proc_act_push(const imodule::request& request) {
-		lock_t lock(stateMutex);
+		shared_lock_t lock(stateMutex);
 		
 		#ifdef THROW
 		if(UNLIKELY(loadedModule == NULL || !loadedModule->is_proc_unit_loaded())) {
 			throw std::runtime_error(err_msg::_nllpntr);
 		}
 		#endif
+		
+		check_deadline(request);
+		
+		return push_invalidating(request);
+	}
+	
+	void module_manager::proc_act_batch(const std::vector<imodule::request>& requests,
+			std::vector<imodule::response*>& responses) {
+		shared_lock_t lock(stateMutex);
+		
+		#ifdef THROW
+		if(UNLIKELY(loadedModule == NULL || !loadedModule->is_proc_unit_loaded())) {
+			throw std::runtime_error(err_msg::_nllpntr);
+		}
+		#endif
+		
+		responses.reserve(responses.size() + requests.size());
+		
+		for(const auto& request : requests) {
+			imodule::response* rspns;
+			
+			/**  \todo Make this catch more specific. */
+			try {
+				// Earlier actions of the batch may have taken it past the deadline
+				check_deadline(request);
+				
+				switch(request.action()) {
+				 case ::actions::actions_t::REQUEST:
+					rspns = request_cached(request);
+					break;
+				
+				 case ::actions::actions_t::PUSH:
+					rspns = new imodule::response(push_invalidating(request),
+							false,
+							request.encoding());
+					break;
+				
+				 default:
+					rspns = new imodule::response(err_msg::_malinpt,
+							true,
+							request.encoding());
+					break;
+				}
+			} catch(const std::exception& e) {
+				rspns = new imodule::response(e.what(), true, request.encoding());
+			}
+			
+			if(UNLIKELY(rspns == NULL)) {
+				// Keeps each response at the position of its request
+				rspns = new imodule::response(err_msg::_nllpntr, true, request.encoding());
+			}
+			
+			responses.push_back(rspns);
+		}
+	}
+	
+	imodule::response* module_manager::request_cached(
+			const imodule::request& request) {
+		if(!loadedModule->is_idempotent(request.method())) {
+			return loadedModule->proc_act_request(request);
+		}
+		
+		auto key = request.key();
+		std::uint64_t generation;
+		
+		{
+			shared_lock_t lock(cacheMutex);
+			
+			const auto it = responseCache.find(key);
+			if(it != responseCache.end()) {
+				return it->second->clone();
+			}
+			
+			generation = cacheGeneration;
+		}
+		
+		const auto rspns = loadedModule->proc_act_request(request);
+		
+		if(UNLIKELY(rspns == NULL)) {
+			return rspns;
+		}
+		
+		// The server appends the request id to the response it is given, so the cache
+		// keeps a copy of its own
+		std::unique_ptr<imodule::response> cached(rspns->clone());
+		
+		lock_t lock(cacheMutex);
+		
+		if(generation == cacheGeneration) {
+			if(UNLIKELY(responseCache.size() >= cache_max_entries)) {
+				responseCache.clear();
+			}
+			
+			responseCache[std::move(key)] = std::move(cached);
+		}
+		
+		return rspns;
+	}
 	
-		return loadedModule->proc_act_push(request);
+	bool module_manager::push_invalidating(const imodule::request& request) {
+		bool result;
+		
+		try {
+			result = loadedModule->proc_act_push(request);
+		} catch(...) {
+			// The push may have changed the state before failing
+			invalidate_cache();
+			throw;
+		}
+		
+		invalidate_cache();
+		
+		return result;
+	}
+	
+	void module_manager::check_deadline(const imodule::request& request) {
+		if(UNLIKELY(request.expired())) {
+			count_expired();
+			throw std::runtime_error(err_msg::_dlnexpd);
+		}
+	}
+	
+	void module_manager::invalidate_cache() {
+		lock_t lock(cacheMutex);
+		
+		responseCache.clear();
+		cacheGeneration++;
 	}
 	
 	bool module_manager::is_module_loaded() {
-		lock_t lock(stateMutex);
+		shared_lock_t lock(stateMutex);
 		
 		return loadedModule != NULL;
 	}
 	
 	bool module_manager::is_proc_unit_loaded() {
-		lock_t lock(stateMutex);
+		shared_lock_t lock(stateMutex);
 		
 		return loadedModule != NULL && loadedModule->is_proc_unit_loaded();
 	}
 	
 	::actions::actions_list_t module_manager::supported_actions() {
-		lock_t lock(stateMutex);
+		shared_lock_t lock(stateMutex);
 		
 		#ifdef THROW
-		if(UNLIKELY(!is_module_loaded() || !loadedModule->is_proc_unit_loaded())) {
+		if(UNLIKELY(loadedModule == NULL || !loadedModule->is_proc_unit_loaded())) {
 			throw std::runtime_error(err_msg::_nllpntr);
 		}
 		#endif
@@ -121,7 +255,7 @@ namespace module {
 	}
 	
 	bool module_manager::is_callback_registered() {
-		lock_t lock(stateMutex);
+		shared_lock_t lock(stateMutex);
 		
 		return (serverCallback.instance == NULL && serverCallback.callback == NULL);
 	}
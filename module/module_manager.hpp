@@ -5,7 +5,14 @@
 #include <module/imodule.hpp>
 #include <module/iproc_unit.hpp>
 #include <module/module_list.hpp>
-#include <mutex>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace net {
 	namespace middleware {
@@ -20,9 +27,14 @@ namespace module {
 	class module_manager {
 	 private:
 		/**
-		 * \brief Standard mutex lock type for the class.
+		 * \brief Exclusive lock type for the class, taken to change the state.
 		 */
-		using lock_t = std::lock_guard<std::mutex>;
+		using lock_t = boost::unique_lock<boost::shared_mutex>;
+		
+		/**
+		 * \brief Shared lock type for the class, taken to use the state.
+		 */
+		using shared_lock_t = boost::shared_lock<boost::shared_mutex>;
 	
 	 public:
 		/**
@@ -134,29 +146,54 @@ namespace module {
 		/**
 		 * \brief Process an incoming request action from a client..
 		 * 
+		 * The response to a method the loaded module marks as idempotent is cached,
+		 * keyed by its method and parameters, and the next request for it is answered
+		 * from the cache until a push is processed or the module or processing unit
+		 * changes.
+		 * 
 		 * \note Threadsafe with respect to the state of the loaded module and processing
 		 * unit, i.e. the currently loaded module and processing unit cannot be unloaded
-		 * while this function is executing. Other threadsafety depends on
-		 * proc_act_request() implementation in the loaded module. See module interface
-		 * class for more details.
+		 * while this function is executing. Calls may run concurrently with each other,
+		 * so other threadsafety depends on the proc_act_request() implementation in the
+		 * loaded module. See module interface class for more details.
 		 * 
-		 * \throws If no module and processing unit is loaded, we throw a runtime_error.
+		 * \throws If no module and processing unit is loaded, or if the deadline of the
+		 * request has passed, we throw a runtime_error.
 		 */
 		imodule::response* proc_act_request(const imodule::request& request);
 		
 		/**
 		 * \brief Process an incoming push action from a client.
 		 * 
+		 * Whether or not it succeeds, this empties the response cache.
+		 * 
 		 * \note Threadsafe with respect to the state of the loaded module and processing
 		 * unit, i.e. the currently loaded module and processing unit cannot be unloaded
-		 * while this function is executing. Other threadsafety depends on
-		 * proc_act_push() implementation in the loaded module. See module interface
-		 * class for more details.
+		 * while this function is executing. Calls may run concurrently with each other,
+		 * so other threadsafety depends on the proc_act_push() implementation in the
+		 * loaded module. See module interface class for more details.
 		 * 
-		 * \throws If no module and processing unit is loaded, we throw a runtime_error.
+		 * \throws If no module and processing unit is loaded, or if the deadline of the
+		 * request has passed, we throw a runtime_error.
 		 */
 		bool proc_act_push(const imodule::request& request);
 		
+		/**
+		 * \brief Process a batch of incoming request and push actions from a client,
+		 * holding the state for the whole batch rather than for each action.
+		 * 
+		 * One response is appended to responses for each request, in order. An action
+		 * that throws, that is neither a request nor a push, or whose deadline has
+		 * passed by its turn, is answered with an error response rather than ending the
+		 * batch.
+		 * 
+		 * \note Threadsafe in the same way as proc_act_request() and proc_act_push().
+		 * 
+		 * \throws If no module and processing unit is loaded, we throw a runtime_error.
+		 */
+		void proc_act_batch(const std::vector<imodule::request>& requests,
+				std::vector<imodule::response*>& responses);
+		
 		/**
 		 * \brief Return whether or not a module is currently loaded.
 		 * 
@@ -212,8 +249,32 @@ namespace module {
 		 * \note Threadsafe.
 		 */
 		bool is_callback_registered();
+		
+		/**
+		 * \brief Return the number of actions dropped because their deadline passed
+		 * before they were processed.
+		 * 
+		 * \note Threadsafe.
+		 */
+		inline std::uint64_t expired_count() const {
+			return expiredCount.load(std::memory_order_relaxed);
+		}
+		
+		/**
+		 * \brief Count an action dropped past its deadline before it reached us.
+		 * 
+		 * \note Threadsafe.
+		 */
+		inline void count_expired() {
+			expiredCount.fetch_add(1, std::memory_order_relaxed);
+		}
 	
 	 private:
+		/**
+		 * \brief The most responses cached before the cache is emptied to make room.
+		 */
+		static const std::size_t cache_max_entries = 4096;
+		
 		/**
 		 * \brief The loaded module.
 		 */
@@ -227,8 +288,70 @@ namespace module {
 		/**
 		 * \brief Mutex for functions modifying the state of the loaded module and
 		 * processing unit.
+		 * 
+		 * Functions that only use the state share it, so the server may process
+		 * several actions at once.
+		 */
+		boost::shared_mutex stateMutex;
+		
+		/**
+		 * \brief Responses to idempotent requests, keyed by request::key().
+		 * 
+		 * The cache belongs to the loaded module and processing unit, so it is
+		 * emptied whenever either changes rather than keyed by them.
+		 */
+		std::unordered_map<std::string, std::unique_ptr<imodule::response>> responseCache;
+		
+		/**
+		 * \brief Number of times the response cache has been emptied.
+		 * 
+		 * A response is only cached if this has not changed since the lookup that
+		 * missed, so a response that raced with a push is never cached.
+		 */
+		std::uint64_t cacheGeneration;
+		
+		/**
+		 * \brief Mutex protector of the response cache and its generation.
+		 * 
+		 * When both are taken, stateMutex is taken first.
+		 */
+		boost::shared_mutex cacheMutex;
+		
+		/**
+		 * \brief The number of actions dropped because their deadline passed.
+		 */
+		std::atomic<std::uint64_t> expiredCount;
+		
+		/**
+		 * \brief Count and throw a runtime_error if the deadline of a request has
+		 * passed, so it is dropped rather than dispatched.
+		 * 
+		 * \note Threadsafe.
+		 */
+		void check_deadline(const imodule::request& request);
+		
+		/**
+		 * \brief Process a request action, answering from the response cache if it is
+		 * idempotent.
+		 * 
+		 * \warning stateMutex must be held and a processing unit loaded.
+		 */
+		imodule::response* request_cached(const imodule::request& request);
+		
+		/**
+		 * \brief Process a push action and empty the response cache, whether or not
+		 * it succeeds.
+		 * 
+		 * \warning stateMutex must be held and a processing unit loaded.
+		 */
+		bool push_invalidating(const imodule::request& request);
+		
+		/**
+		 * \brief Empty the response cache.
+		 * 
+		 * \note Threadsafe.
 		 */
-		std::mutex stateMutex;
+		void invalidate_cache();
 	};
 }
 
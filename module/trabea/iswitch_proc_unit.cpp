@@ -2,6 +2,22 @@
 
 namespace module {
 	namespace trabea{
+		const iswitch_proc_unit::request_table_t iswitch_proc_unit::requestMethods({
+			{
+				"get_state",
+				MODULE_METHOD_ANSWERED(request_table_t, &iswitch_proc_unit::get_switch_state),
+				true
+			}
+		});
+		
+		const iswitch_proc_unit::push_table_t iswitch_proc_unit::pushMethods({
+			{
+				"configure",
+				MODULE_METHOD_UNPACKED(push_table_t, &iswitch_proc_unit::set_switch_state),
+				false
+			}
+		});
+		
 		iswitch_proc_unit::iswitch_proc_unit() {
 		}
 		
@@ -22,36 +38,18 @@ namespace module {
 				const iswitch_proc_unit::request& request) {
 			lock_t lock(stateMutex);
 			
-			const auto action = request.method();
-			response* ret = NULL;
-			
-			if(strcmp(action, "get_state") == 0) {
-				const auto result = get_switch_state(request.parameter<std::size_t>(0),
-						request.parameter<std::size_t>(1));
-				
-				ret = new response(result);
-			} else {
-				throw std::runtime_error(err_msg::_malinpt);
-			}
-			
-			return ret;
+			return requestMethods.call(*this, request);
 		}
 		
 		bool iswitch_proc_unit::proc_act_push(
 				const iswitch_proc_unit::request& request) {
 			lock_t lock(stateMutex);
 			
-			const auto action = request.method();
-			bool ret = false;
-			
-			if(strcmp(action, "configure") == 0) {
-				ret = set_switch_state(request.parameter<std::size_t>(0),
-						request.parameter<std::size_t>(1));
-			} else {
-				throw std::runtime_error(err_msg::_malinpt);
-			}
-			
-			return ret;
+			return pushMethods.call(*this, request);
+		}
+		
+		bool iswitch_proc_unit::is_idempotent(const char* const method) const {
+			return requestMethods.is_idempotent(method);
 		}
 	}
 }
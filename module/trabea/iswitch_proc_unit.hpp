@@ -3,6 +3,7 @@
 
 #include <common.hpp>
 #include <module/iproc_unit.hpp>
+#include <module/method_table.hpp>
 #include <arpa/inet.h>
 
 namespace module {
@@ -88,6 +89,16 @@ namespace module {
 			 * \note Threadsafe.
 			 */
 			bool proc_act_push(const request& request);
+			
+			/**
+			 * \brief Return whether or not a request method is idempotent.
+			 * 
+			 * The state of a switch only changes when it is configured, so get_state
+			 * is.
+			 * 
+			 * \note Threadsafe.
+			 */
+			bool is_idempotent(const char* const method) const;
 		
 		 protected:
 			/**
@@ -111,6 +122,26 @@ namespace module {
 					const std::size_t outPort) = 0;
 		
 		 private:
+			/**
+			 * \brief Alias declaration type of the table of request methods.
+			 */
+			using request_table_t = ::module::method_table<iswitch_proc_unit, response*>;
+			
+			/**
+			 * \brief Alias declaration type of the table of push methods.
+			 */
+			using push_table_t = ::module::method_table<iswitch_proc_unit, bool>;
+			
+			/**
+			 * \brief The request methods of a switch.
+			 */
+			static const request_table_t requestMethods;
+			
+			/**
+			 * \brief The push methods of a switch.
+			 */
+			static const push_table_t pushMethods;
+			
 			/**
 			 * \brief Mutex protector of the state of the switch.
 			 */
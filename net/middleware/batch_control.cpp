@@ -0,0 +1,76 @@
+#include "batch_control.hpp"
+#include <algorithm>
+
+/**
+ * \brief The weight of the newest sample in the arrival rate average.
+ * 
+ * Larger follows a change in rate sooner, smaller rides out bursts.
+ */
+#define NET_BATCH_RATE_WEIGHT 0.25
+
+namespace net {
+	namespace middleware {
+		batch_control::batch_control(const config& configuration,
+				const std::size_t fixedBatch,
+				const std::size_t fixedWait,
+				const std::size_t fixedFail)
+				: batchMode(configuration.batchMode),
+				targetLatency(configuration.targetLatency),
+				maxBatch(configuration.maxBatch),
+				currentBatch(fixedBatch),
+				currentWait(fixedWait),
+				currentFail(fixedFail),
+				arrivalRate(-1),
+				lastDrain(steady_clock_t::now()) {
+			if(batchMode == mode::adaptive) {
+				if(UNLIKELY(targetLatency == 0 || maxBatch == 0)) {
+					throw std::invalid_argument(err_msg::_zrlngth);
+				}
+				
+				// The wait itself bounds the latency, so every timeout drains
+				currentBatch = std::min(fixedBatch, maxBatch);
+				currentWait = targetLatency;
+				currentFail = 1;
+			}
+		}
+		
+		batch_control::~batch_control() {
+		}
+		
+		bool batch_control::record_drain(const std::size_t itemCount) {
+			if(batchMode == mode::fixed) {
+				return false;
+			}
+			
+			const auto now = steady_clock_t::now();
+			const auto elapsed = std::chrono::duration<double, std::milli>(
+					now - lastDrain).count();
+			lastDrain = now;
+			
+			if(UNLIKELY(elapsed <= 0)) {
+				return false;
+			}
+			
+			const auto sample = itemCount / elapsed;
+			if(arrivalRate < 0) {
+				arrivalRate = sample;
+			} else {
+				arrivalRate = NET_BATCH_RATE_WEIGHT * sample +
+						(1 - NET_BATCH_RATE_WEIGHT) * arrivalRate;
+			}
+			
+			// Fill in half the target so the batch, not the timeout, normally ends the
+			// wait even as the rate wanders
+			const auto fill = static_cast<std::size_t>(arrivalRate * targetLatency / 2);
+			const auto batch = std::max<std::size_t>(1, std::min(fill, maxBatch));
+			
+			if(batch == currentBatch) {
+				return false;
+			}
+			
+			currentBatch = batch;
+			
+			return true;
+		}
+	}
+}
@@ -0,0 +1,174 @@
+#ifndef _NET_MIDDLEWARE_BATCH_CONTROL_HPP
+#define _NET_MIDDLEWARE_BATCH_CONTROL_HPP
+
+#include <common.hpp>
+#include <chrono>
+
+namespace net {
+	namespace middleware {
+		/**
+		 * \brief Decides how many items the async sender waits for before emptying the
+		 * buffer, and for how long.
+		 * 
+		 * In fixed mode the values given at construction are used as is. In adaptive
+		 * mode the arrival rate is estimated from every drain with an exponentially
+		 * weighted moving average, and the batch is sized so it fills in half the target
+		 * latency at that rate. The wait never exceeds the target latency, so a sudden
+		 * drop in rate costs at most one target latency before the estimate catches up.
+		 */
+		class batch_control {
+		 private:
+			/**
+			 * \brief The clock drains are timed with.
+			 */
+			using steady_clock_t = std::chrono::steady_clock;
+		
+		 public:
+			/**
+			 * \brief How the batch size is chosen.
+			 */
+			enum class mode {
+				/**
+				 * \brief Constant batch size and wait.
+				 */
+				fixed,
+				
+				/**
+				 * \brief Batch size follows the arrival rate to meet a target latency.
+				 */
+				adaptive
+			};
+			
+			/**
+			 * \brief Configuration of the adaptive mode.
+			 */
+			struct config {
+			 public:
+				/**
+				 * \brief Constructor sets the defaults, which keep the fixed mode.
+				 */
+				config()
+						: batchMode(mode::fixed),
+						targetLatency(50),
+						maxBatch(1000) {
+				}
+				
+				/**
+				 * \brief How the batch size is chosen.
+				 */
+				mode batchMode;
+				
+				/**
+				 * \brief The latency an item should not wait beyond before it is sent.
+				 * 
+				 * \note Milliseconds.
+				 */
+				std::size_t targetLatency;
+				
+				/**
+				 * \brief The largest batch waited for.
+				 */
+				std::size_t maxBatch;
+			};
+			
+			/**
+			 * \brief Constructor.
+			 * 
+			 * The fixed values are what the fixed mode uses, and the adaptive mode starts
+			 * from fixedBatch until it has seen the arrival rate.
+			 * 
+			 * \throws If the adaptive mode is configured with a zero target latency or
+			 * max batch we throw an invalid_argument.
+			 */
+			batch_control(const config& configuration,
+					const std::size_t fixedBatch,
+					const std::size_t fixedWait,
+					const std::size_t fixedFail);
+			
+			/**
+			 * \brief Destructor.
+			 */
+			~batch_control();
+			
+			/**
+			 * \brief Return the number of items to wait for before emptying the buffer.
+			 */
+			inline std::size_t batch() const {
+				return currentBatch;
+			}
+			
+			/**
+			 * \brief Return how long to wait for a batch at a time.
+			 * 
+			 * \note Milliseconds.
+			 */
+			inline std::size_t wait() const {
+				return currentWait;
+			}
+			
+			/**
+			 * \brief Return the number of waits that may time out in a row before the
+			 * buffer is emptied anyway.
+			 */
+			inline std::size_t fail_limit() const {
+				return currentFail;
+			}
+			
+			/**
+			 * \brief Account for a drain of the buffer that took itemCount items.
+			 * 
+			 * \returns Whether or not batch() changed.
+			 */
+			bool record_drain(const std::size_t itemCount);
+		
+		 private:
+			/**
+			 * \brief How the batch size is chosen.
+			 */
+			const mode batchMode;
+			
+			/**
+			 * \brief The latency an item should not wait beyond before it is sent.
+			 * 
+			 * \note Milliseconds.
+			 */
+			const std::size_t targetLatency;
+			
+			/**
+			 * \brief The largest batch waited for.
+			 */
+			const std::size_t maxBatch;
+			
+			/**
+			 * \brief The number of items to wait for.
+			 */
+			std::size_t currentBatch;
+			
+			/**
+			 * \brief How long to wait for a batch at a time.
+			 * 
+			 * \note Milliseconds.
+			 */
+			std::size_t currentWait;
+			
+			/**
+			 * \brief The number of waits that may time out in a row.
+			 */
+			std::size_t currentFail;
+			
+			/**
+			 * \brief The estimated arrival rate, negative until the first sample.
+			 * 
+			 * \note Items per millisecond.
+			 */
+			double arrivalRate;
+			
+			/**
+			 * \brief When the buffer was last drained.
+			 */
+			steady_clock_t::time_point lastDrain;
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef _NET_MIDDLEWARE_ENCODING_HPP
+#define _NET_MIDDLEWARE_ENCODING_HPP
+
+#include <common.hpp>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * \brief The first byte of a message in the binary encoding.
+ * 
+ * No JSON text can start with it, so it tells the encodings apart per message.
+ */
+#define NET_MIDDLEWARE_BINARY_MAGIC 0xB5
+
+namespace net {
+	namespace middleware {
+		/**
+		 * \brief The wire encodings of requests and responses.
+		 * 
+		 * A binary request is the magic byte, the action as the byte of its
+		 * actions_t value, a byte of request flags, the id, deadline and timeout as
+		 * 64-bit unsigned integers if the flags say so, the method as a string value,
+		 * a byte counting the parameters, and then the parameters as values.
+		 * 
+		 * A binary response is the magic byte, a byte of response flags, the result
+		 * as a value, and the id as a 64-bit unsigned integer if the flags say so.
+		 * 
+		 * A value is a tag byte followed by nothing for null and booleans, 8 bytes for
+		 * numbers, a 32-bit length, the bytes and a null terminator for strings, and a
+		 * 32-bit count and that many scalar values for arrays. Objects, which only
+		 * results may be, are a 32-bit count and that many pairs of a string value
+		 * naming a member and a scalar value. Integers are in network byte order, and
+		 * doubles are sent as the integer of their bits.
+		 * 
+		 * Strings are null terminated on the wire so they can be used in place. They
+		 * may hold any bytes, including nulls, within their length.
+		 */
+		namespace encoding {
+			/**
+			 * \brief The encoding of a message.
+			 */
+			enum class encoding_t : std::uint8_t {
+				JSON,
+				BINARY
+			};
+			
+			/**
+			 * \brief The tag before a value in the binary encoding.
+			 */
+			enum class tag_t : std::uint8_t {
+				NONE = 0,
+				BOOL_FALSE = 1,
+				BOOL_TRUE = 2,
+				INTEGER = 3,
+				UNSIGNED_INTEGER = 4,
+				REAL = 5,
+				STRING = 6,
+				ARRAY = 7,
+				OBJECT = 8
+			};
+			
+			/**
+			 * \brief Request flag saying an id follows.
+			 */
+			const std::uint8_t _rqsthid = 0x01;
+			
+			/**
+			 * \brief Request flag saying a deadline follows.
+			 */
+			const std::uint8_t _rqsthdl = 0x02;
+			
+			/**
+			 * \brief Request flag saying a timeout follows.
+			 */
+			const std::uint8_t _rqsthto = 0x04;
+			
+			/**
+			 * \brief Response flag saying the result is an error.
+			 */
+			const std::uint8_t _rspnerr = 0x01;
+			
+			/**
+			 * \brief Response flag saying an id follows the result.
+			 */
+			const std::uint8_t _rspnhid = 0x02;
+			
+			/**
+			 * \brief Return the encoding of a message.
+			 */
+			inline encoding_t of(const void* const data, const std::size_t size) {
+				const auto first = static_cast<const std::uint8_t*>(data);
+				
+				return size != 0 && *first == NET_MIDDLEWARE_BINARY_MAGIC ?
+						encoding_t::BINARY : encoding_t::JSON;
+			}
+			
+			/**
+			 * \brief Read a 32-bit unsigned integer in network byte order.
+			 */
+			inline std::uint32_t read_u32(const char* const in) {
+				std::uint32_t result;
+				std::memcpy(&result, in, sizeof(result));
+				
+				return NTH_BYTE_ORD(result);
+			}
+			
+			/**
+			 * \brief Read a 64-bit unsigned integer in network byte order.
+			 */
+			inline std::uint64_t read_u64(const char* const in) {
+				std::uint64_t result;
+				std::memcpy(&result, in, sizeof(result));
+				
+				return NTH_BYTE_ORD(result);
+			}
+			
+			/**
+			 * \brief Write a 32-bit unsigned integer in network byte order.
+			 */
+			inline void write_u32(char* const out, const std::uint32_t value) {
+				const std::uint32_t ordered = HTN_BYTE_ORD(value);
+				std::memcpy(out, &ordered, sizeof(ordered));
+			}
+			
+			/**
+			 * \brief Write a 64-bit unsigned integer in network byte order.
+			 */
+			inline void write_u64(char* const out, const std::uint64_t value) {
+				const std::uint64_t ordered = HTN_BYTE_ORD(value);
+				std::memcpy(out, &ordered, sizeof(ordered));
+			}
+		}
+	}
+}
+
+#endif
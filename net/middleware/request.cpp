@@ -0,0 +1,679 @@
+#include "request.hpp"
+#include <rapidjson/reader.h>
+#include <algorithm>
+
+namespace net {
+	namespace middleware {
+		/**
+		 * \brief The SAX handler that decodes a request, or a JSON array of them, as the
+		 * reader walks the input.
+		 * 
+		 * Members of a request other than those we know are skipped, along with
+		 * anything nested in them. Parameters may be scalars or arrays of scalars.
+		 * Returning false from an event stops the reader with an error.
+		 */
+		struct request::decoder
+				: public ::rapidjson::BaseReaderHandler<::rapidjson::UTF8<>, decoder> {
+		 public:
+			/**
+			 * \brief The member of the request whose value is being read.
+			 */
+			enum class member {
+				none,
+				action,
+				method,
+				parameters,
+				id,
+				deadline,
+				timeout,
+				other
+			};
+			
+			/**
+			 * \brief Constructor decodes into a single request, or appends to a batch if
+			 * one is given.
+			 */
+			decoder(request* const target, std::vector<request>* const batch)
+					: target(target),
+					batch(batch),
+					inBatch(false),
+					depth(0),
+					skipDepth(0),
+					current(member::none) {
+			}
+			
+			bool Null() {
+				value val;
+				val.type = value_type::null;
+				val.size = 0;
+				
+				return put(val);
+			}
+			
+			bool Bool(const bool b) {
+				value val;
+				val.type = value_type::boolean;
+				val.size = 0;
+				val.boolean = b;
+				
+				return put(val);
+			}
+			
+			bool Int(const int i) {
+				return Int64(i);
+			}
+			
+			bool Uint(const unsigned u) {
+				return Uint64(u);
+			}
+			
+			bool Int64(const std::int64_t i) {
+				value val;
+				val.type = value_type::integer;
+				val.size = 0;
+				val.integer = i;
+				
+				return put(val);
+			}
+			
+			bool Uint64(const std::uint64_t u) {
+				if(depth == 1 && skipDepth == 0) {
+					switch(current) {
+					 case member::id:
+						target->_hasId = true;
+						target->_id = u;
+						return true;
+					
+					 case member::deadline:
+						target->bring_deadline(system_clock_t::time_point(), u);
+						return true;
+					
+					 case member::timeout:
+						target->bring_deadline(system_clock_t::now(), u);
+						return true;
+					
+					 default:
+						break;
+					}
+				}
+				
+				value val;
+				val.type = value_type::unsigned_integer;
+				val.size = 0;
+				val.unsignedInteger = u;
+				
+				return put(val);
+			}
+			
+			bool Double(const double d) {
+				value val;
+				val.type = value_type::real;
+				val.size = 0;
+				val.real = d;
+				
+				return put(val);
+			}
+			
+			bool String(const char* const str,
+					const ::rapidjson::SizeType length,
+					const bool copy) {
+				// Parsing in place leaves strings null terminated within the input
+				UNUSED(copy);
+				
+				if(depth == 1 && skipDepth == 0) {
+					switch(current) {
+					 case member::action:
+						target->_action = ::actions::str_map(str);
+						target->_hasAction = true;
+						return true;
+					
+					 case member::method:
+						target->_method = str;
+						return true;
+					
+					 default:
+						break;
+					}
+				}
+				
+				value val;
+				val.type = value_type::string;
+				val.size = length;
+				val.string = str;
+				
+				return put(val);
+			}
+			
+			bool Key(const char* const str,
+					const ::rapidjson::SizeType length,
+					const bool copy) {
+				UNUSED(length);
+				UNUSED(copy);
+				
+				if(skipDepth != 0) {
+					return true;
+				}
+				
+				if(std::strcmp(str, NET_MIDDLEWARE_REQUEST_ACTION_STR) == 0) {
+					current = member::action;
+				} else if(std::strcmp(str, NET_MIDDLEWARE_REQUEST_METHOD_STR) == 0) {
+					current = member::method;
+				} else if(std::strcmp(str, NET_MIDDLEWARE_REQUEST_PARAMS_STR) == 0) {
+					current = member::parameters;
+				} else if(std::strcmp(str, NET_MIDDLEWARE_REQUEST_ID_STR) == 0) {
+					current = member::id;
+				} else if(std::strcmp(str, NET_MIDDLEWARE_REQUEST_DEADLINE_STR) == 0) {
+					current = member::deadline;
+				} else if(std::strcmp(str, NET_MIDDLEWARE_REQUEST_TIMEOUT_STR) == 0) {
+					current = member::timeout;
+				} else {
+					current = member::other;
+				}
+				
+				return true;
+			}
+			
+			bool StartObject() {
+				if(skipDepth != 0 || (depth == 1 && current == member::other)) {
+					skipDepth++;
+					return true;
+				}
+				
+				if(depth != 0) {
+					return false;
+				}
+				
+				if(batch != NULL) {
+					if(!inBatch) {
+						return false;
+					}
+					
+					batch->push_back(request());
+					target = &batch->back();
+				}
+				
+				depth = 1;
+				current = member::none;
+				
+				return true;
+			}
+			
+			bool EndObject(const ::rapidjson::SizeType count) {
+				UNUSED(count);
+				
+				if(skipDepth != 0) {
+					skipDepth--;
+					return true;
+				}
+				
+				depth = 0;
+				
+				return target->complete();
+			}
+			
+			bool StartArray() {
+				if(skipDepth != 0 || (depth == 1 && current == member::other)) {
+					skipDepth++;
+					return true;
+				}
+				
+				switch(depth) {
+				 case 0:
+					// A batch is an array of requests
+					if(batch == NULL || inBatch) {
+						return false;
+					}
+					
+					inBatch = true;
+					return true;
+				
+				 case 1:
+					if(current != member::parameters) {
+						return false;
+					}
+					
+					depth = 2;
+					return true;
+				
+				 case 2:
+					{
+						value val;
+						val.type = value_type::array;
+						val.size = 0;
+						val.first = target->_elementCount;
+						
+						if(!put(val)) {
+							return false;
+						}
+						
+						depth = 3;
+						return true;
+					}
+				
+				 default:
+					return false;
+				}
+			}
+			
+			bool EndArray(const ::rapidjson::SizeType count) {
+				if(skipDepth != 0) {
+					skipDepth--;
+					return true;
+				}
+				
+				switch(depth) {
+				 case 0:
+					inBatch = false;
+					return true;
+				
+				 case 3:
+					target->_parameters[target->_parameterCount - 1].size = count;
+					depth = 2;
+					return true;
+				
+				 default:
+					depth = 1;
+					return true;
+				}
+			}
+		
+		 private:
+			/**
+			 * \brief The request being decoded.
+			 */
+			request* target;
+			
+			/**
+			 * \brief The batch requests are appended to, or NULL to decode one.
+			 */
+			std::vector<request>* const batch;
+			
+			/**
+			 * \brief Whether or not the reader is within the array of a batch.
+			 */
+			bool inBatch;
+			
+			/**
+			 * \brief Where the reader is within a request; 0 outside of it, 1 within the
+			 * object, 2 within the parameters, and 3 within an array parameter.
+			 */
+			std::size_t depth;
+			
+			/**
+			 * \brief How deep the reader is within the value of a skipped member.
+			 */
+			std::size_t skipDepth;
+			
+			/**
+			 * \brief The member of the request whose value is being read.
+			 */
+			member current;
+			
+			/**
+			 * \brief Store a scalar, or the start of an array parameter, where the reader
+			 * is.
+			 */
+			inline bool put(const value& val) {
+				if(skipDepth != 0) {
+					return true;
+				}
+				
+				switch(depth) {
+				 case 1:
+					// A value of the wrong type for a member we know is malformed
+					return current == member::other;
+				
+				 case 2:
+					if(UNLIKELY(target->_parameterCount == NET_MIDDLEWARE_REQUEST_MAX_PARAMS)) {
+						return false;
+					}
+					
+					target->_parameters[target->_parameterCount++] = val;
+					return true;
+				
+				 case 3:
+					if(UNLIKELY(target->_elementCount == target->_elementCapacity)) {
+						target->grow_elements();
+					}
+					
+					target->_elements[target->_elementCount++] = val;
+					return true;
+				
+				 default:
+					return false;
+				}
+			}
+		};
+		
+		request::request()
+				: _action(::actions::actions_t::REQUEST),
+				_hasAction(false),
+				_method(NULL),
+				_hasId(false),
+				_id(0),
+				_hasDeadline(false),
+				_parameterCount(0),
+				_encoding(encoding::encoding_t::JSON),
+				_elements(_inlineElements),
+				_elementCount(0),
+				_elementCapacity(NET_MIDDLEWARE_REQUEST_INLINE_ELEMENTS) {
+		}
+		
+		request::request(char* const input)
+				: request() {
+			const auto decoded = decode_json(input);
+			
+			#ifdef THROW
+			if(UNLIKELY(!decoded)) {
+				throw std::runtime_error(err_msg::_malinpt);
+			}
+			#else
+			UNUSED(decoded);
+			#endif
+		}
+		
+		request::request(char* const input, const std::size_t size)
+				: request() {
+			const auto decoded = decode(input, size);
+			
+			#ifdef THROW
+			if(UNLIKELY(!decoded)) {
+				throw std::runtime_error(err_msg::_malinpt);
+			}
+			#else
+			UNUSED(decoded);
+			#endif
+		}
+		
+		request::request(char* const input, const std::size_t size, bool& decoded)
+				: request() {
+			decoded = decode(input, size);
+		}
+		
+		bool request::decode_batch(char* const input, std::vector<request>& requests) {
+			decoder handler(NULL, &requests);
+			::rapidjson::InsituStringStream stream(input);
+			::rapidjson::Reader reader;
+			reader.Parse<::rapidjson::kParseInsituFlag>(stream, handler);
+			
+			return !reader.HasParseError();
+		}
+		
+		std::string request::key() const {
+			std::string result(method());
+			result.push_back('\0');
+			result.push_back(static_cast<char>(_encoding));
+			
+			// Only equal requests need equal keys, so the raw bytes of each value serve
+			for(std::size_t i = 0; i < _parameterCount; i++) {
+				const auto& param = _parameters[i];
+				
+				append_key(result, param);
+				
+				if(param.type == value_type::array) {
+					for(std::size_t j = 0; j < param.size; j++) {
+						append_key(result, element(param, j));
+					}
+				}
+			}
+			
+			return result;
+		}
+		
+		bool request::decode(char* const input, const std::size_t size) {
+			if(encoding::of(input, size) == encoding::encoding_t::BINARY) {
+				return decode_binary(input, size);
+			}
+			
+			return size != 0 && input[size - 1] == '\0' && decode_json(input);
+		}
+		
+		bool request::decode_json(char* const input) {
+			decoder handler(this, NULL);
+			::rapidjson::InsituStringStream stream(input);
+			::rapidjson::Reader reader;
+			reader.Parse<::rapidjson::kParseInsituFlag>(stream, handler);
+			
+			return !reader.HasParseError() && complete();
+		}
+		
+		bool request::decode_binary(char* const input, const std::size_t size) {
+			const char* pos = input + 1;
+			const char* const end = input + size;
+			
+			_encoding = encoding::encoding_t::BINARY;
+			
+			if(UNLIKELY(end - pos < 2)) {
+				return false;
+			}
+			
+			const auto action = static_cast<std::uint8_t>(*pos++);
+			switch(static_cast<::actions::actions_t>(action)) {
+			 case ::actions::actions_t::PUSH:
+			 case ::actions::actions_t::WAIT:
+			 case ::actions::actions_t::REQUEST:
+			 case ::actions::actions_t::REPLY:
+				_action = static_cast<::actions::actions_t>(action);
+				_hasAction = true;
+				break;
+			
+			 default:
+				return false;
+			}
+			
+			const auto flags = static_cast<std::uint8_t>(*pos++);
+			if(UNLIKELY((flags & ~(encoding::_rqsthid |
+					encoding::_rqsthdl |
+					encoding::_rqsthto)) != 0)) {
+				return false;
+			}
+			
+			const auto fields = ((flags & encoding::_rqsthid) != 0) +
+					((flags & encoding::_rqsthdl) != 0) +
+					((flags & encoding::_rqsthto) != 0);
+			if(UNLIKELY(end - pos < fields * static_cast<int>(sizeof(std::uint64_t)))) {
+				return false;
+			}
+			
+			if(flags & encoding::_rqsthid) {
+				_hasId = true;
+				_id = encoding::read_u64(pos);
+				pos += sizeof(std::uint64_t);
+			}
+			
+			if(flags & encoding::_rqsthdl) {
+				bring_deadline(system_clock_t::time_point(), encoding::read_u64(pos));
+				pos += sizeof(std::uint64_t);
+			}
+			
+			if(flags & encoding::_rqsthto) {
+				bring_deadline(system_clock_t::now(), encoding::read_u64(pos));
+				pos += sizeof(std::uint64_t);
+			}
+			
+			value method;
+			if(UNLIKELY(!read_value(pos, end, method, true) ||
+					method.type != value_type::string ||
+					pos == end)) {
+				return false;
+			}
+			
+			_method = method.string;
+			
+			const auto count = static_cast<std::uint8_t>(*pos++);
+			if(UNLIKELY(count > NET_MIDDLEWARE_REQUEST_MAX_PARAMS)) {
+				return false;
+			}
+			
+			for(; _parameterCount < count; _parameterCount++) {
+				if(UNLIKELY(!read_value(pos, end, _parameters[_parameterCount], false))) {
+					return false;
+				}
+			}
+			
+			return pos == end;
+		}
+		
+		bool request::read_value(const char*& pos,
+				const char* const end,
+				value& val,
+				const bool element) {
+			if(UNLIKELY(pos == end)) {
+				return false;
+			}
+			
+			const auto tag = static_cast<encoding::tag_t>(*pos++);
+			const auto left = static_cast<std::size_t>(end - pos);
+			val.size = 0;
+			
+			switch(tag) {
+			 case encoding::tag_t::NONE:
+				val.type = value_type::null;
+				return true;
+			
+			 case encoding::tag_t::BOOL_FALSE:
+			 case encoding::tag_t::BOOL_TRUE:
+				val.type = value_type::boolean;
+				val.boolean = tag == encoding::tag_t::BOOL_TRUE;
+				return true;
+			
+			 case encoding::tag_t::INTEGER:
+			 case encoding::tag_t::UNSIGNED_INTEGER:
+			 case encoding::tag_t::REAL:
+				{
+					if(UNLIKELY(left < sizeof(std::uint64_t))) {
+						return false;
+					}
+					
+					const auto bits = encoding::read_u64(pos);
+					pos += sizeof(std::uint64_t);
+					
+					if(tag == encoding::tag_t::INTEGER) {
+						val.type = value_type::integer;
+						val.integer = static_cast<std::int64_t>(bits);
+					} else if(tag == encoding::tag_t::UNSIGNED_INTEGER) {
+						val.type = value_type::unsigned_integer;
+						val.unsignedInteger = bits;
+					} else {
+						val.type = value_type::real;
+						std::memcpy(&val.real, &bits, sizeof(val.real));
+					}
+					
+					return true;
+				}
+			
+			 case encoding::tag_t::STRING:
+				{
+					if(UNLIKELY(left < sizeof(std::uint32_t))) {
+						return false;
+					}
+					
+					const std::size_t length = encoding::read_u32(pos);
+					pos += sizeof(std::uint32_t);
+					
+					// The terminator lets the string be used in place
+					if(UNLIKELY(left - sizeof(std::uint32_t) <= length ||
+							pos[length] != '\0')) {
+						return false;
+					}
+					
+					val.type = value_type::string;
+					val.size = length;
+					val.string = pos;
+					pos += length + 1;
+					
+					return true;
+				}
+			
+			 case encoding::tag_t::ARRAY:
+				{
+					if(UNLIKELY(element || left < sizeof(std::uint32_t))) {
+						return false;
+					}
+					
+					// Every element takes at least its tag, so a count past the end of the
+					// input fails before it can run away
+					val.type = value_type::array;
+					val.size = encoding::read_u32(pos);
+					val.first = _elementCount;
+					pos += sizeof(std::uint32_t);
+					
+					for(std::size_t i = 0; i < val.size; i++) {
+						value elem;
+						if(UNLIKELY(!read_value(pos, end, elem, true))) {
+							return false;
+						}
+						
+						if(UNLIKELY(_elementCount == _elementCapacity)) {
+							grow_elements();
+						}
+						
+						_elements[_elementCount++] = elem;
+					}
+					
+					return true;
+				}
+			
+			 default:
+				return false;
+			}
+		}
+		
+		void request::append_key(std::string& key, const value& val) {
+			key.push_back(static_cast<char>(val.type));
+			
+			switch(val.type) {
+			 case value_type::null:
+				break;
+			
+			 case value_type::boolean:
+				key.push_back(val.boolean ? 1 : 0);
+				break;
+			
+			 case value_type::integer:
+				key.append(reinterpret_cast<const char*>(&val.integer), sizeof(val.integer));
+				break;
+			
+			 case value_type::unsigned_integer:
+				key.append(reinterpret_cast<const char*>(&val.unsignedInteger),
+						sizeof(val.unsignedInteger));
+				break;
+			
+			 case value_type::real:
+				key.append(reinterpret_cast<const char*>(&val.real), sizeof(val.real));
+				break;
+			
+			 case value_type::string:
+				key.append(reinterpret_cast<const char*>(&val.size), sizeof(val.size));
+				key.append(val.string, val.size);
+				break;
+			
+			 case value_type::array:
+				key.append(reinterpret_cast<const char*>(&val.size), sizeof(val.size));
+				break;
+			}
+		}
+		
+		void request::bring_deadline(const system_clock_t::time_point from,
+				const std::uint64_t milliseconds) {
+			const auto deadline = from + std::chrono::duration_cast<system_clock_t::duration>(
+					std::chrono::milliseconds(milliseconds));
+			
+			// Given both a deadline and a timeout, the earlier of the two applies
+			if(!_hasDeadline || deadline < _deadline) {
+				_hasDeadline = true;
+				_deadline = deadline;
+			}
+		}
+		
+		void request::grow_elements() {
+			const auto capacity = _elementCapacity * 2;
+			std::unique_ptr<value[]> elements(new value[capacity]);
+			std::copy(_elements, _elements + _elementCount, elements.get());
+			
+			_heapElements = std::move(elements);
+			_elements = _heapElements.get();
+			_elementCapacity = capacity;
+		}
+	}
+}
@@ -3,7 +3,13 @@
 
 #include <common.hpp>
 #include <actions.hpp>
-#include <rapidjson/document.h>
+#include "encoding.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
 
 /**
  * \brief The JSON object name that holds the action value.
@@ -20,28 +26,261 @@
  */
 #define NET_MIDDLEWARE_REQUEST_PARAMS_STR "parameters"
 
+/**
+ * \brief The JSON object name that holds the optional correlation id value.
+ */
+#define NET_MIDDLEWARE_REQUEST_ID_STR "id"
+
+/**
+ * \brief The JSON object name that holds the optional absolute deadline value, in
+ * milliseconds since the Unix epoch.
+ */
+#define NET_MIDDLEWARE_REQUEST_DEADLINE_STR "deadline"
+
+/**
+ * \brief The JSON object name that holds the optional relative deadline value, in
+ * milliseconds from when the request is decoded.
+ */
+#define NET_MIDDLEWARE_REQUEST_TIMEOUT_STR "timeout"
+
+/**
+ * \brief The most parameters a request may have.
+ */
+#define NET_MIDDLEWARE_REQUEST_MAX_PARAMS 16
+
+/**
+ * \brief The number of elements of array parameters a request holds without
+ * allocating.
+ */
+#define NET_MIDDLEWARE_REQUEST_INLINE_ELEMENTS 64
+
 namespace net {
 	namespace middleware {
 		/**
 		 * \brief A request from the client.
+		 * 
+		 * A request is encoded as JSON or, if it starts with
+		 * NET_MIDDLEWARE_BINARY_MAGIC, in the binary encoding described in
+		 * encoding.hpp.
+		 * 
+		 * JSON is decoded in a single pass of a SAX reader, without a DOM, into the
+		 * action, method, id and deadline, and a fixed capacity vector of typed
+		 * parameters. Elements of array parameters are held in the request too, up to
+		 * NET_MIDDLEWARE_REQUEST_INLINE_ELEMENTS of them, beyond which they move to the
+		 * heap. Strings are not copied, and point into the input, which is parsed in
+		 * place.
+		 * 
+		 * \warning The input must outlive the request.
 		 */
 		struct request {
+		 private:
+			/**
+			 * \brief The clock deadlines are given in.
+			 */
+			using system_clock_t = std::chrono::system_clock;
+			
+			/**
+			 * \brief The SAX handler that decodes requests, defined in the
+			 * implementation.
+			 */
+			struct decoder;
+			
+			/**
+			 * \brief The type of a decoded value.
+			 */
+			enum class value_type : std::uint8_t {
+				null,
+				boolean,
+				integer,
+				unsigned_integer,
+				real,
+				string,
+				array
+			};
+			
+			/**
+			 * \brief A decoded parameter or element of an array parameter.
+			 */
+			struct value {
+			 public:
+				/**
+				 * \brief The type of the value, which says which member of the union
+				 * holds it.
+				 */
+				value_type type;
+				
+				/**
+				 * \brief The length of a string or the number of elements of an array.
+				 */
+				std::size_t size;
+				
+				union {
+					bool boolean;
+					std::int64_t integer;
+					std::uint64_t unsignedInteger;
+					double real;
+					const char* string;
+					
+					/**
+					 * \brief The index of the first element of an array.
+					 */
+					std::size_t first;
+				};
+			};
+		
 		 public:
 			/**
-			 * \brief Decoding constructor takes in json in mutable cstring.
+			 * \brief A view of the elements of an array parameter as type T.
+			 * 
+			 * The view does not own or copy the elements, each of which is converted when
+			 * it is read, so taking one never allocates.
+			 * 
+			 * \warning The view is only valid while its request is neither moved nor
+			 * destroyed.
 			 */
-			request(char* const input)
-					: _dom() {
-				_dom.ParseInsitu(input);
+			template <typename T> class array_view {
+			 public:
+				/**
+				 * \brief Iterator over the elements of the view.
+				 */
+				class const_iterator {
+				 public:
+					/**
+					 * \brief Constructor.
+					 */
+					const_iterator(const value* const pos)
+							: pos(pos) {
+					}
+					
+					/**
+					 * \brief Return the element at the iterator.
+					 */
+					inline T operator*() const {
+						return as<T>(*pos);
+					}
+					
+					/**
+					 * \brief Move to the next element.
+					 */
+					inline const_iterator& operator++() {
+						pos++;
+						
+						return *this;
+					}
+					
+					/**
+					 * \brief Return whether or not two iterators are at the same element.
+					 */
+					inline bool operator==(const const_iterator& other) const {
+						return pos == other.pos;
+					}
+					
+					/**
+					 * \brief Return whether or not two iterators are at different elements.
+					 */
+					inline bool operator!=(const const_iterator& other) const {
+						return pos != other.pos;
+					}
 				
-				#ifdef THROW
-				if(UNLIKELY(!_dom.HasMember(NET_MIDDLEWARE_REQUEST_ACTION_STR))) {
-					throw std::runtime_error(err_msg::_malinpt);
+				 private:
+					/**
+					 * \brief The element at the iterator.
+					 */
+					const value* pos;
+				};
+				
+				/**
+				 * \brief Constructor.
+				 */
+				array_view(const value* const first, const std::size_t size)
+						: first(first),
+						count(size) {
 				}
-				#endif
 				
-				_action = ::actions::str_map(_dom[NET_MIDDLEWARE_REQUEST_ACTION_STR].GetString());
-			}
+				/**
+				 * \brief Return the number of elements.
+				 */
+				inline std::size_t size() const {
+					return count;
+				}
+				
+				/**
+				 * \brief Return whether or not the array has no elements.
+				 */
+				inline bool empty() const {
+					return count == 0;
+				}
+				
+				/**
+				 * \brief Return an element by index.
+				 */
+				inline T operator[](const std::size_t i) const {
+					return as<T>(first[i]);
+				}
+				
+				/**
+				 * \brief Return an element by index.
+				 * 
+				 * \throws If the index is out of bounds we throw an out_of_range.
+				 */
+				inline T at(const std::size_t i) const {
+					if(UNLIKELY(i >= count)) {
+						throw std::out_of_range(err_msg::_arybnds);
+					}
+					
+					return as<T>(first[i]);
+				}
+				
+				/**
+				 * \brief Return an iterator at the first element.
+				 */
+				inline const_iterator begin() const {
+					return const_iterator(first);
+				}
+				
+				/**
+				 * \brief Return an iterator past the last element.
+				 */
+				inline const_iterator end() const {
+					return const_iterator(first + count);
+				}
+			
+			 private:
+				/**
+				 * \brief The first element.
+				 */
+				const value* first;
+				
+				/**
+				 * \brief The number of elements.
+				 */
+				std::size_t count;
+			};
+			
+			/**
+			 * \brief Decoding constructor takes in json in mutable cstring.
+			 * 
+			 * \throws If the input is not a request we throw a runtime_error.
+			 */
+			request(char* const input);
+			
+			/**
+			 * \brief Decoding constructor takes in a mutable message of either encoding.
+			 * 
+			 * JSON must still be null terminated.
+			 * 
+			 * \throws If the input is not a request we throw a runtime_error.
+			 */
+			request(char* const input, const std::size_t size);
+			
+			/**
+			 * \brief Decoding constructor takes in a mutable message of either encoding,
+			 * setting decoded to whether or not it is a request rather than throwing.
+			 * 
+			 * Lets input from any client be answered when it is malformed. A request
+			 * that was not decoded must not be used.
+			 */
+			request(char* const input, const std::size_t size, bool& decoded);
 			
 			/**
 			 * \brief Constructor for directly feeding data from a zmq message.
@@ -62,7 +301,19 @@ namespace net {
 			 * \brief Move constructor.
 			 */
 			request(request&& old)
-					: _dom(std::move(old._dom)) {
+					: _action(old._action),
+					_hasAction(old._hasAction),
+					_method(old._method),
+					_hasId(old._hasId),
+					_id(old._id),
+					_hasDeadline(old._hasDeadline),
+					_deadline(old._deadline),
+					_parameterCount(old._parameterCount),
+					_encoding(old._encoding),
+					_heapElements(std::move(old._heapElements)),
+					_elementCount(old._elementCount),
+					_elementCapacity(old._elementCapacity) {
+				move_values(old);
 			}
 			
 			 /**
@@ -74,37 +325,104 @@ namespace net {
 			 * \brief Move assignment operator.
 			 */
 			request& operator=(request&& old) {
-				_dom = std::move(old._dom);
+				_action = old._action;
+				_hasAction = old._hasAction;
+				_method = old._method;
+				_hasId = old._hasId;
+				_id = old._id;
+				_hasDeadline = old._hasDeadline;
+				_deadline = old._deadline;
+				_parameterCount = old._parameterCount;
+				_encoding = old._encoding;
+				_heapElements = std::move(old._heapElements);
+				_elementCount = old._elementCount;
+				_elementCapacity = old._elementCapacity;
+				move_values(old);
 				
 				return *this;
 			}
 			
+			/**
+			 * \brief Decode a JSON array of requests, appending them to requests.
+			 * 
+			 * The requests share the input, which is parsed in place.
+			 * 
+			 * \returns Whether or not the input is an array of requests. If not, some of
+			 * them may have been appended.
+			 */
+			static bool decode_batch(char* const input, std::vector<request>& requests);
+			
 			/**
 			 * \brief Return the method.
 			 */
 			inline const char* method() const {
-				return _dom[NET_MIDDLEWARE_REQUEST_METHOD_STR].GetString();
+				#ifdef THROW
+				if(UNLIKELY(_method == NULL)) {
+					throw std::runtime_error(err_msg::_malinpt);
+				}
+				#endif
+				
+				return _method;
 			}
 			
 			/**
 			 * \brief Return a type T parameter by index.
 			 * 
-			 * \warning You must use a template specialized function.
+			 * \warning T must be a type with a specialization of as().
+			 */
+			template <typename T> inline T parameter(const std::size_t idx) const {
+				return as<T>(parameter_value(idx));
+			}
+			
+			/**
+			 * \brief Return a view of a type T array parameter by index.
+			 * 
+			 * \warning T must be a type with a specialization of as().
 			 */
-			template <typename T> inline T parameter(const std::size_t idx) const;
+			template <typename T>
+					inline array_view<T> parameter_array(const std::size_t idx) const {
+				const auto& param = array_value(idx);
+				
+				return array_view<T>(_elements + param.first, param.size);
+			}
 			
 			/**
 			 * \brief Return the size of a parameter string by index.
 			 */
 			inline std::size_t parameter_str_size(const std::size_t idx) const {
-				return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetStringLength();
+				const auto& param = parameter_value(idx);
+				
+				#ifdef THROW
+				if(UNLIKELY(param.type != value_type::string)) {
+					throw std::runtime_error(err_msg::_malinpt);
+				}
+				#endif
+				
+				return param.size;
 			}
 			
 			/**
 			 * \brief Return the size of a parameter array by index.
 			 */
 			inline std::size_t parameter_array_size(const std::size_t idx) const {
-				return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
+				return array_value(idx).size;
+			}
+			
+			/**
+			 * \brief Return a key that is equal for requests of the same method with the
+			 * same parameters, whatever their action or id.
+			 * 
+			 * This is the method, a null separator, the encoding, then the type and
+			 * contents of each parameter. The encoding is part of it since it is also the
+			 * encoding of the response.
+			 */
+			std::string key() const;
+			
+			/**
+			 * \brief Return the encoding of the request, in which it must be answered.
+			 */
+			inline encoding::encoding_t encoding() const {
+				return _encoding;
 			}
 			
 			/**
@@ -113,274 +431,417 @@ namespace net {
 			inline ::actions::actions_t action() const {
 				return _action;
 			}
-		
-		 private:
+			
+			/**
+			 * \brief Return whether or not the client gave the request an id.
+			 */
+			inline bool has_id() const {
+				return _hasId;
+			}
+			
+			/**
+			 * \brief Return the id the client gave the request, which is echoed in the
+			 * response so the client can match the two when several are in flight.
+			 * 
+			 * \warning Only meaningful if has_id() is true.
+			 */
+			inline std::uint64_t id() const {
+				return _id;
+			}
+			
 			/**
-			 * \brief The rapidjson DOM object that holds our JSON.
+			 * \brief Return whether or not the client gave the request a deadline.
 			 */
-			::rapidjson::Document _dom;
+			inline bool has_deadline() const {
+				return _hasDeadline;
+			}
 			
+			/**
+			 * \brief Return whether or not the deadline of the request has passed, after
+			 * which nobody is waiting for it to be processed.
+			 * 
+			 * A request without a deadline never expires.
+			 */
+			inline bool expired() const {
+				return _hasDeadline && system_clock_t::now() >= _deadline;
+			}
+		
+		 private:
 			/**
 			 * \brief The action type of the request.
 			 */
 			::actions::actions_t _action;
+			
+			/**
+			 * \brief Whether or not the request has an action.
+			 */
+			bool _hasAction;
+			
+			/**
+			 * \brief The method, or NULL if the request has none.
+			 */
+			const char* _method;
+			
+			/**
+			 * \brief Whether or not the request has an id.
+			 */
+			bool _hasId;
+			
+			/**
+			 * \brief The id of the request.
+			 */
+			std::uint64_t _id;
+			
+			/**
+			 * \brief Whether or not the request has a deadline.
+			 */
+			bool _hasDeadline;
+			
+			/**
+			 * \brief When the request stops being worth processing.
+			 */
+			system_clock_t::time_point _deadline;
+			
+			/**
+			 * \brief The parameters.
+			 */
+			value _parameters[NET_MIDDLEWARE_REQUEST_MAX_PARAMS];
+			
+			/**
+			 * \brief The number of parameters.
+			 */
+			std::size_t _parameterCount;
+			
+			/**
+			 * \brief The encoding of the request.
+			 */
+			encoding::encoding_t _encoding;
+			
+			/**
+			 * \brief The elements of array parameters, while they fit.
+			 */
+			value _inlineElements[NET_MIDDLEWARE_REQUEST_INLINE_ELEMENTS];
+			
+			/**
+			 * \brief The elements of array parameters, once they do not fit inline.
+			 */
+			std::unique_ptr<value[]> _heapElements;
+			
+			/**
+			 * \brief The elements of array parameters, inline or on the heap.
+			 */
+			value* _elements;
+			
+			/**
+			 * \brief The number of elements of array parameters.
+			 */
+			std::size_t _elementCount;
+			
+			/**
+			 * \brief The number of elements that fit before they move.
+			 */
+			std::size_t _elementCapacity;
+			
+			/**
+			 * \brief Constructor of an empty request, for the decoder to fill.
+			 */
+			request();
+			
+			/**
+			 * \brief Return whether or not the members decoded make a request, which
+			 * needs an action, and a method if it is a request or push.
+			 */
+			inline bool complete() const {
+				return _hasAction && (_method != NULL ||
+						(_action != ::actions::actions_t::REQUEST &&
+						_action != ::actions::actions_t::PUSH));
+			}
+			
+			/**
+			 * \brief Decode a message of either encoding in place.
+			 * 
+			 * \returns Whether or not the input is a request.
+			 */
+			bool decode(char* const input, const std::size_t size);
+			
+			/**
+			 * \brief Decode JSON in place.
+			 * 
+			 * \returns Whether or not the input is a request.
+			 */
+			bool decode_json(char* const input);
+			
+			/**
+			 * \brief Decode the binary encoding in place.
+			 * 
+			 * \returns Whether or not the input is a request.
+			 */
+			bool decode_binary(char* const input, const std::size_t size);
+			
+			/**
+			 * \brief Read a value of the binary encoding at pos, moving pos past it.
+			 * 
+			 * Elements of an array are stored with those of the other array parameters.
+			 * 
+			 * \returns Whether or not a value, which must be a scalar if element is true,
+			 * lies between pos and end.
+			 */
+			bool read_value(const char*& pos,
+					const char* const end,
+					value& val,
+					const bool element);
+			
+			/**
+			 * \brief Append the type and contents of a value to a key.
+			 */
+			static void append_key(std::string& key, const value& val);
+			
+			/**
+			 * \brief Bring the deadline forward to a number of milliseconds after a time
+			 * point, if that is earlier.
+			 */
+			void bring_deadline(const system_clock_t::time_point from,
+					const std::uint64_t milliseconds);
+			
+			/**
+			 * \brief Double the room for elements of array parameters, moving them to the
+			 * heap.
+			 */
+			void grow_elements();
+			
+			/**
+			 * \brief Take the parameters and elements of a request being moved from.
+			 * 
+			 * \warning The heap elements must have been moved already.
+			 */
+			inline void move_values(request& old) {
+				std::memcpy(_parameters, old._parameters, _parameterCount * sizeof(value));
+				
+				if(old._elements == old._inlineElements) {
+					std::memcpy(_inlineElements,
+							old._inlineElements,
+							_elementCount * sizeof(value));
+					_elements = _inlineElements;
+				} else {
+					_elements = _heapElements.get();
+				}
+				
+				old._parameterCount = 0;
+				old._elements = old._inlineElements;
+				old._elementCount = 0;
+				old._elementCapacity = NET_MIDDLEWARE_REQUEST_INLINE_ELEMENTS;
+			}
+			
+			/**
+			 * \brief Return a parameter by index.
+			 */
+			inline const value& parameter_value(const std::size_t idx) const {
+				#ifdef THROW
+				if(UNLIKELY(idx >= _parameterCount)) {
+					throw std::out_of_range(err_msg::_arybnds);
+				}
+				#endif
+				
+				return _parameters[idx];
+			}
+			
+			/**
+			 * \brief Return an array parameter by index.
+			 */
+			inline const value& array_value(const std::size_t idx) const {
+				const auto& result = parameter_value(idx);
+				
+				#ifdef THROW
+				if(UNLIKELY(result.type != value_type::array)) {
+					throw std::runtime_error(err_msg::_malinpt);
+				}
+				#endif
+				
+				return result;
+			}
+			
+			/**
+			 * \brief Return an element of an array parameter.
+			 */
+			inline const value& element(const value& array, const std::size_t i) const {
+				return _elements[array.first + i];
+			}
+			
+			/**
+			 * \brief Return a value as type T.
+			 * 
+			 * \warning You must use a template specialized function.
+			 */
+			template <typename T> static inline T as(const value& val);
+			
+			/**
+			 * \brief Return a value as a bool.
+			 */
+			static inline bool bool_value(const value& val) {
+				#ifdef THROW
+				if(UNLIKELY(val.type != value_type::boolean)) {
+					throw std::runtime_error(err_msg::_malinpt);
+				}
+				#endif
+				
+				return val.boolean;
+			}
+			
+			/**
+			 * \brief Return a value as a signed integer.
+			 */
+			static inline std::int64_t integer_value(const value& val) {
+				#ifdef THROW
+				if(UNLIKELY(val.type != value_type::integer &&
+						val.type != value_type::unsigned_integer)) {
+					throw std::runtime_error(err_msg::_malinpt);
+				}
+				#endif
+				
+				return val.type == value_type::integer ?
+						val.integer : static_cast<std::int64_t>(val.unsignedInteger);
+			}
+			
+			/**
+			 * \brief Return a value as an unsigned integer.
+			 */
+			static inline std::uint64_t unsigned_value(const value& val) {
+				#ifdef THROW
+				if(UNLIKELY(val.type != value_type::unsigned_integer)) {
+					throw std::runtime_error(err_msg::_malinpt);
+				}
+				#endif
+				
+				return val.unsignedInteger;
+			}
+			
+			/**
+			 * \brief Return a value as a floating point number.
+			 */
+			static inline double real_value(const value& val) {
+				switch(val.type) {
+				 case value_type::integer:
+					return static_cast<double>(val.integer);
+				
+				 case value_type::unsigned_integer:
+					return static_cast<double>(val.unsignedInteger);
+				
+				 case value_type::real:
+					return val.real;
+				
+				 default:
+					#ifdef THROW
+					throw std::runtime_error(err_msg::_malinpt);
+					#endif
+					
+					return 0;
+				}
+			}
+			
+			/**
+			 * \brief Return a value as a cstring.
+			 */
+			static inline const char* string_value(const value& val) {
+				#ifdef THROW
+				if(UNLIKELY(val.type != value_type::string)) {
+					throw std::runtime_error(err_msg::_malinpt);
+				}
+				#endif
+				
+				return val.string;
+			}
 		};
 		
 		/**
-		 * \brief Return a cstring parameter by index.
+		 * \brief Return a value as a cstring.
 		 */
 		template <> inline const char*
-				request::parameter<const char*>(const std::size_t idx) const {
-			return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetString();
+				request::as<const char*>(const value& val) {
+			return string_value(val);
 		}
 		
 		/**
-		 * \brief Return a cstring array parameter by index.
-		 * 
-		 * \note Pointer returned must be deallocated. The strings do not need to be
-		 * deallocated.
-		 */
-		template <> inline const char* const*
-				request::parameter<const char* const*>(const std::size_t idx) const {
-			auto size = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
-			auto array = new const char*[size];
-			for(std::size_t i = 0; i < size; i++) {
-				array[i] = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx][i].GetString();
-			}
-			
-			return array;
-		}
-		
-		/**
-		 * \brief Return a bool parameter by index.
+		 * \brief Return a value as a bool.
 		 */
 		template <> inline bool
-				request::parameter<bool>(const std::size_t idx) const {
-			return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetBool();
-		}
-		
-		/**
-		 * \brief Return a bool array parameter by index.
-		 * 
-		 * \note Pointer returned must be deallocated.
-		 */
-		template <> inline bool*
-				request::parameter<bool*>(const std::size_t idx) const {
-			auto size = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
-			auto array = new bool[size];
-			for(std::size_t i = 0; i < size; i++) {
-				array[i] = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx][i].GetBool();
-			}
-			
-			return array;
+				request::as<bool>(const value& val) {
+			return bool_value(val);
 		}
 		
 		/**
-		 * \brief Return a char parameter by index.
+		 * \brief Return a value as a char, the first of a string.
 		 */
 		template <> inline char
-				request::parameter<char>(const std::size_t idx) const {
-			return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetString()[0];
+				request::as<char>(const value& val) {
+			return string_value(val)[0];
 		}
 		
 		/**
-		 * \brief Return an unsigned short parameter by index.
+		 * \brief Return a value as an unsigned short.
 		 * 
 		 * \warning Possible loss of precision.
 		 */
 		template <> inline unsigned short
-				request::parameter<unsigned short>(const std::size_t idx) const {
-			return static_cast<unsigned short>(_dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetUint());
-		}
-		
-		/**
-		 * \brief Return an unsigned short array parameter by index.
-		 * 
-		 * \warning Possible loss of precision.
-		 * 
-		 * \note Pointer returned must be deallocated.
-		 */
-		template <> inline unsigned short*
-				request::parameter<unsigned short*>(const std::size_t idx) const {
-			auto size = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
-			auto array = new unsigned short[size];
-			for(std::size_t i = 0; i < size; i++) {
-				array[i] = static_cast<unsigned short>(_dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx][i].GetUint());
-			}
-			
-			return array;
+				request::as<unsigned short>(const value& val) {
+			return static_cast<unsigned short>(unsigned_value(val));
 		}
 		
 		/**
-		 * \brief Return a short parameter by index.
+		 * \brief Return a value as a short.
 		 * 
 		 * \warning Possible loss of precision.
 		 */
 		template <> inline short
-				request::parameter<short>(const std::size_t idx) const {
-			return static_cast<short>(_dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetInt());
+				request::as<short>(const value& val) {
+			return static_cast<short>(integer_value(val));
 		}
 		
 		/**
-		 * \brief Return a short array parameter by index.
-		 * 
-		 * \warning Possible loss of precision.
-		 * 
-		 * \note Pointer returned must be deallocated.
-		 */
-		template <> inline short*
-				request::parameter<short*>(const std::size_t idx) const {
-			auto size = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
-			auto array = new short[size];
-			for(std::size_t i = 0; i < size; i++) {
-				array[i] = static_cast<short>(_dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx][i].GetInt());
-			}
-			
-			return array;
-		}
-		
-		/**
-		 * \brief Return an unsigned int parameter by index.
+		 * \brief Return a value as an unsigned int.
 		 */
 		template <> inline unsigned int
-				request::parameter<unsigned int>(const std::size_t idx) const {
-			return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetUint();
+				request::as<unsigned int>(const value& val) {
+			return static_cast<unsigned int>(unsigned_value(val));
 		}
 		
 		/**
-		 * \brief Return an unsigned int array parameter by index.
-		 * 
-		 * \note Pointer returned must be deallocated.
-		 */
-		template <> inline unsigned int*
-				request::parameter<unsigned int*>(const std::size_t idx) const {
-			auto size = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
-			auto array = new unsigned int[size];
-			for(std::size_t i = 0; i < size; i++) {
-				array[i] = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx][i].GetUint();
-			}
-			
-			return array;
-		}
-		
-		/**
-		 * \brief Return an int parameter by index.
+		 * \brief Return a value as an int.
 		 */
 		template <> inline int
-				request::parameter<int>(const std::size_t idx) const {
-			return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetInt();
-		}
-		
-		/**
-		 * \brief Return an int array parameter by index.
-		 * 
-		 * \note Pointer returned must be deallocated.
-		 */
-		template <> inline int*
-				request::parameter<int*>(const std::size_t idx) const {
-			auto size = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
-			auto array = new int[size];
-			for(std::size_t i = 0; i < size; i++) {
-				array[i] = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx][i].GetInt();
-			}
-			
-			return array;
+				request::as<int>(const value& val) {
+			return static_cast<int>(integer_value(val));
 		}
 		
 		/**
-		 * \brief Return an unsigned long int parameter by index.
+		 * \brief Return a value as an unsigned long int.
 		 */
 		template <> inline unsigned long int
-				request::parameter<unsigned long int>(const std::size_t idx) const {
-			return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetUint64();
-		}
-		
-		/**
-		 * \brief Return an unsigned long int array parameter by index.
-		 * 
-		 * \note Pointer returned must be deallocated.
-		 */
-		template <> inline unsigned long int*
-				request::parameter<unsigned long int*>(const std::size_t idx) const {
-			auto size = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
-			auto array = new unsigned long int[size];
-			for(std::size_t i = 0; i < size; i++) {
-				array[i] = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx][i].GetUint64();
-			}
-			
-			return array;
+				request::as<unsigned long int>(const value& val) {
+			return static_cast<unsigned long int>(unsigned_value(val));
 		}
 		
 		/**
-		 * \brief Return a long int parameter by index.
+		 * \brief Return a value as a long int.
 		 */
 		template <> inline long int
-				request::parameter<long int>(const std::size_t idx) const {
-			return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetInt64();
+				request::as<long int>(const value& val) {
+			return static_cast<long int>(integer_value(val));
 		}
 		
 		/**
-		 * \brief Return a long int array parameter by index.
-		 * 
-		 * \note Pointer returned must be deallocated.
-		 */
-		template <> inline long int*
-				request::parameter<long int*>(const std::size_t idx) const {
-			auto size = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
-			auto array = new long int[size];
-			for(std::size_t i = 0; i < size; i++) {
-				array[i] = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx][i].GetInt64();
-			}
-			
-			return array;
-		}
-		
-		/**
-		 * \brief Return a float parameter by index.
+		 * \brief Return a value as a float.
 		 */
 		template <> inline float
-				request::parameter<float>(const std::size_t idx) const {
-			return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetDouble();
+				request::as<float>(const value& val) {
+			return static_cast<float>(real_value(val));
 		}
 		
 		/**
-		 * \brief Return a float array parameter by index.
-		 * 
-		 * \note Pointer returned must be deallocated.
-		 */
-		template <> inline float*
-				request::parameter<float*>(const std::size_t idx) const {
-			auto size = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
-			auto array = new float[size];
-			for(std::size_t i = 0; i < size; i++) {
-				array[i] = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx][i].GetDouble();
-			}
-			
-			return array;
-		}
-		
-		/**
-		 * \brief Return a double parameter by index.
+		 * \brief Return a value as a double.
 		 */
 		template <> inline double
-				request::parameter<double>(const std::size_t idx) const {
-			return _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].GetDouble();
-		}
-		
-		/**
-		 * \brief Return a double array parameter by index.
-		 * 
-		 * \note Pointer returned must be deallocated.
-		 */
-		template <> inline double*
-				request::parameter<double*>(const std::size_t idx) const {
-			auto size = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx].Size();
-			auto array = new double[size];
-			for(std::size_t i = 0; i < size; i++) {
-				array[i] = _dom[NET_MIDDLEWARE_REQUEST_PARAMS_STR][idx][i].GetDouble();
-			}
-			
-			return array;
+				request::as<double>(const value& val) {
+			return real_value(val);
 		}
 	}
 }
@@ -2,9 +2,15 @@
 #define _NET_MIDDLEWARE_RESPONSE_HPP
 
 #include <common.hpp>
-#include <rapidjson/document.h>
+#include "encoding.hpp"
+#include <buffer/slab_allocator.hpp>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
 
 /**
  * \brief The JSON object name that holds the result value.
@@ -16,79 +22,196 @@
  */
 #define NET_MIDDLEWARE_REQUEST_ERROR_STR "error"
 
+/**
+ * \brief The JSON object name that holds the id of the request answered.
+ */
+#define NET_MIDDLEWARE_RESPONSE_ID_STR "id"
+
+/**
+ * \brief The bytes a response buffer starts with, which fit a scalar result and an id
+ * in the smallest slab size class.
+ */
+#define NET_MIDDLEWARE_RESPONSE_CAPACITY 64
+
 namespace net {
 	namespace middleware {
 		/**
-		 * \brief A JSON reponse to a client.
+		 * \brief A reponse to a client, in JSON or the binary encoding.
+		 * 
+		 * A response is in the encoding of the request it answers, which the
+		 * constructors are given.
+		 * 
+		 * The result is written straight into the buffer, without a DOM. Responses and
+		 * their buffers are allocated from the slab allocator, so they are reused rather
+		 * than taken from the heap, and those deleted by zmq on its I/O thread once sent
+		 * go back to the thread that wrote them.
 		 */
 		struct response {
+		 private:
+			/**
+			 * \brief A rapidjson allocator drawing from the slab allocator.
+			 */
+			struct pooled_allocator {
+			 public:
+				/**
+				 * \brief Tells rapidjson that memory must be freed.
+				 */
+				static const bool kNeedFree = true;
+				
+				/**
+				 * \brief Allocate a block of at least size bytes.
+				 */
+				inline void* Malloc(const std::size_t size) {
+					return size == 0 ? NULL : ::buffer::slab_allocator::allocate(size);
+				}
+				
+				/**
+				 * \brief Grow a block, keeping its contents.
+				 */
+				inline void* Realloc(void* const original,
+						const std::size_t originalSize,
+						const std::size_t newSize) {
+					if(original == NULL) {
+						return Malloc(newSize);
+					}
+					
+					if(newSize == 0) {
+						Free(original);
+						return NULL;
+					}
+					
+					if(newSize <= originalSize) {
+						return original;
+					}
+					
+					auto result = Malloc(newSize);
+					std::memcpy(result, original, originalSize);
+					Free(original);
+					
+					return result;
+				}
+				
+				/**
+				 * \brief Give back a block.
+				 */
+				static inline void Free(void* const block) {
+					::buffer::slab_allocator::deallocate(static_cast<char*>(block));
+				}
+				
+				/**
+				 * \brief Return the allocator every buffer and writer shares, which holds
+				 * no state of its own.
+				 */
+				static inline pooled_allocator* shared() {
+					static pooled_allocator allocator;
+					
+					return &allocator;
+				}
+			};
+			
+			/**
+			 * \brief Alias declaration type of the buffer of an encoded response.
+			 */
+			using buffer_t = ::rapidjson::GenericStringBuffer<::rapidjson::UTF8<>,
+					pooled_allocator>;
+			
+			/**
+			 * \brief Alias declaration type of the writer of a JSON response.
+			 */
+			using writer_t = ::rapidjson::Writer<buffer_t,
+					::rapidjson::UTF8<>,
+					::rapidjson::UTF8<>,
+					pooled_allocator>;
+		
 		 public:
 			/**
 			 * \brief Direct object initializer for C string type result.
 			 */
-			response(const char* const result, bool error = false) {
+			response(const char* const result,
+					bool error = false,
+					const encoding::encoding_t enc = encoding::encoding_t::JSON)
+					: response(enc) {
 				#ifdef THROW
 				if(UNLIKELY(result == 0)) {
 					throw std::invalid_argument(err_msg::_nllpntr);
 				}
 				#endif
 				
-				auto dom(dom_setup());
-				dom.AddMember(NET_MIDDLEWARE_REQUEST_RESULT_STR,
-						::rapidjson::Value(result, dom.GetAllocator()),
-						dom.GetAllocator());
-				dom_error(dom, error);
-				dom_json(dom);
+				scalar(result, error);
 			}
 			
 			/**
 			 * \brief Direct object initializer for bool type result.
 			 */
-			response(const bool result, const bool error = false) {
-				auto dom(dom_setup());
-				dom.AddMember(NET_MIDDLEWARE_REQUEST_RESULT_STR, result, dom.GetAllocator());
-				dom_error(dom, error);
-				dom_json(dom);
+			response(const bool result,
+					const bool error = false,
+					const encoding::encoding_t enc = encoding::encoding_t::JSON)
+					: response(enc) {
+				scalar(result, error);
 			}
 			
 			/**
 			 * \brief Direct object initializer for an int type result.
 			 */
-			response(const int result, const bool error = false) {
-				auto dom(dom_setup());
-				dom.AddMember(NET_MIDDLEWARE_REQUEST_RESULT_STR, result, dom.GetAllocator());
-				dom_error(dom, error);
-				dom_json(dom);
+			response(const int result,
+					const bool error = false,
+					const encoding::encoding_t enc = encoding::encoding_t::JSON)
+					: response(enc) {
+				scalar(result, error);
 			}
 			
 			/**
 			 * \brief Direct object initializer for an unsigned int type result.
 			 */
-			response(const unsigned int result, const bool error = false) {
-				auto dom(dom_setup());
-				dom.AddMember(NET_MIDDLEWARE_REQUEST_RESULT_STR, result, dom.GetAllocator());
-				dom_error(dom, error);
-				dom_json(dom);
+			response(const unsigned int result,
+					const bool error = false,
+					const encoding::encoding_t enc = encoding::encoding_t::JSON)
+					: response(enc) {
+				scalar(result, error);
 			}
 			
 			/**
 			 * \brief Direct object initializer for a long int type result.
 			 */
-			response(const long int result, const bool error = false) {
-				auto dom(dom_setup());
-				dom.AddMember(NET_MIDDLEWARE_REQUEST_RESULT_STR, result, dom.GetAllocator());
-				dom_error(dom, error);
-				dom_json(dom);
+			response(const long int result,
+					const bool error = false,
+					const encoding::encoding_t enc = encoding::encoding_t::JSON)
+					: response(enc) {
+				scalar(result, error);
 			}
 			
 			/**
 			 * \brief Direct object initializer for an unsigned long int type result.
 			 */
-			response(const unsigned long int result, const bool error = false) {
-				auto dom(dom_setup());
-				dom.AddMember(NET_MIDDLEWARE_REQUEST_RESULT_STR, result, dom.GetAllocator());
-				dom_error(dom, error);
-				dom_json(dom);
+			response(const unsigned long int result,
+					const bool error = false,
+					const encoding::encoding_t enc = encoding::encoding_t::JSON)
+					: response(enc) {
+				scalar(result, error);
+			}
+			
+			/**
+			 * \brief Array initializer joining the responses to a batch, in order.
+			 * 
+			 * The responses are deleted once joined. Only JSON arrays are answered this
+			 * way, so the responses must be JSON.
+			 */
+			response(const std::vector<response*>& batch)
+					: response(encoding::encoding_t::JSON) {
+				_jbuffer.Put('[');
+				
+				for(std::size_t i = 0; i < batch.size(); i++) {
+					if(i != 0) {
+						_jbuffer.Put(',');
+					}
+					
+					std::memcpy(_jbuffer.Push(batch[i]->size()),
+							batch[i]->json(),
+							batch[i]->size());
+					delete batch[i];
+				}
+				
+				_jbuffer.Put(']');
 			}
 			
 			/**
@@ -100,19 +223,21 @@ namespace net {
 			 * \brief Move constructor.
 			 */
 			response(response&& old)
-					: _jbuffer(std::move(old._jbuffer)) {
+					: _jbuffer(std::move(old._jbuffer)),
+					_encoding(old._encoding) {
 			}
 			
 			/**
 			 * \brief Assignment operator is disabled.
 			 */
-			response& operator=(const response&) = delete; 
+			response& operator=(const response&) = delete;
 			
 			/**
 			 * \brief Move assignment operator.
 			 */
 			response& operator=(response&& old) {
 				_jbuffer = std::move(old._jbuffer);
+				_encoding = old._encoding;
 				
 				return *this;
 			}
@@ -123,50 +248,412 @@ namespace net {
 			~response() {
 			}
 			
+			/**
+			 * \brief Allocate a response from the slab allocator.
+			 */
+			static inline void* operator new(const std::size_t size) {
+				return ::buffer::slab_allocator::allocate(size);
+			}
+			
+			/**
+			 * \brief Give a response back to the slab allocator, from any thread.
+			 */
+			static inline void operator delete(void* const ptr) {
+				::buffer::slab_allocator::deallocate(static_cast<char*>(ptr));
+			}
+			
+			/**
+			 * \brief Return a new response whose result is an array of values of type T.
+			 * 
+			 * T may be any type a response has a constructor for, or a double.
+			 */
+			template <typename T> static inline response* array(const T* const values,
+					const std::size_t count,
+					const encoding::encoding_t enc = encoding::encoding_t::JSON) {
+				auto result = new response(enc);
+				writer_t writer(result->_jbuffer, pooled_allocator::shared());
+				
+				result->begin();
+				
+				if(enc == encoding::encoding_t::BINARY) {
+					result->binary_tag(encoding::tag_t::ARRAY);
+					result->binary_u32(count);
+				} else {
+					writer.StartArray();
+				}
+				
+				for(std::size_t i = 0; i < count; i++) {
+					result->put(writer, values[i]);
+				}
+				
+				if(enc == encoding::encoding_t::JSON) {
+					writer.EndArray(static_cast<::rapidjson::SizeType>(count));
+				}
+				
+				result->end(false);
+				
+				return result;
+			}
+			
+			/**
+			 * \brief Return a new response whose result is an object whose members are
+			 * named by keys and hold values of type T.
+			 * 
+			 * T may be any type a response has a constructor for, or a double.
+			 */
+			template <typename T> static inline response* object(
+					const char* const* const keys,
+					const T* const values,
+					const std::size_t count,
+					const encoding::encoding_t enc = encoding::encoding_t::JSON) {
+				auto result = new response(enc);
+				writer_t writer(result->_jbuffer, pooled_allocator::shared());
+				
+				result->begin();
+				
+				if(enc == encoding::encoding_t::BINARY) {
+					result->binary_tag(encoding::tag_t::OBJECT);
+					result->binary_u32(count);
+				} else {
+					writer.StartObject();
+				}
+				
+				for(std::size_t i = 0; i < count; i++) {
+					if(enc == encoding::encoding_t::BINARY) {
+						result->put(writer, keys[i]);
+					} else {
+						writer.Key(keys[i]);
+					}
+					
+					result->put(writer, values[i]);
+				}
+				
+				if(enc == encoding::encoding_t::JSON) {
+					writer.EndObject(static_cast<::rapidjson::SizeType>(count));
+				}
+				
+				result->end(false);
+				
+				return result;
+			}
+			
+			/**
+			 * \brief Return a new response whose result is a buffer of bytes.
+			 * 
+			 * A binary response carries the bytes as they are. JSON cannot, so a JSON
+			 * response carries them as a base64 string.
+			 */
+			static inline response* bytes(const void* const data,
+					const std::size_t size,
+					const encoding::encoding_t enc = encoding::encoding_t::JSON) {
+				auto result = new response(enc);
+				const auto in = static_cast<const unsigned char*>(data);
+				
+				result->begin();
+				
+				if(enc == encoding::encoding_t::BINARY) {
+					result->binary_tag(encoding::tag_t::STRING);
+					result->binary_u32(size);
+					
+					auto out = result->_jbuffer.Push(size + 1);
+					std::memcpy(out, in, size);
+					out[size] = '\0';
+				} else {
+					static const char alphabet[] =
+							"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+					
+					auto out = result->_jbuffer.Push((size + 2) / 3 * 4 + 2);
+					*out++ = '"';
+					
+					for(std::size_t i = 0; i < size; i += 3) {
+						const std::uint32_t group = (in[i] << 16) |
+								(i + 1 < size ? in[i + 1] << 8 : 0) |
+								(i + 2 < size ? in[i + 2] : 0);
+						
+						*out++ = alphabet[(group >> 18) & 0x3F];
+						*out++ = alphabet[(group >> 12) & 0x3F];
+						*out++ = i + 1 < size ? alphabet[(group >> 6) & 0x3F] : '=';
+						*out++ = i + 2 < size ? alphabet[group & 0x3F] : '=';
+					}
+					
+					*out = '"';
+				}
+				
+				result->end(false);
+				
+				return result;
+			}
+			
+			/**
+			 * \brief Return a new response holding a copy of this one's data.
+			 * 
+			 * Copying is explicit rather than by constructor, since it is only wanted
+			 * where a response is kept to answer again.
+			 */
+			inline response* clone() const {
+				auto result = new response(_encoding);
+				std::memcpy(result->_jbuffer.Push(size()), data(), size());
+				
+				return result;
+			}
+			
 			/**
 			 * \brief Return a JSON encoded string of the object.
+			 * 
+			 * \warning Only meaningful for a JSON response.
 			 */
 			inline const char* json() const {
 				return _jbuffer.GetString();
 			}
 			
 			/**
-			 * \brief Return the number of character of the JSON string.
+			 * \brief Return the encoded response, whatever its encoding.
+			 */
+			inline const char* data() const {
+				return _jbuffer.GetString();
+			}
+			
+			/**
+			 * \brief Return the encoding of the response.
+			 */
+			inline encoding::encoding_t encoding() const {
+				return _encoding;
+			}
+			
+			/**
+			 * \brief Return the number of bytes of the encoded response.
 			 * 
 			 * \note Does not include null terminator.
 			 */
 			inline std::size_t size() const {
 				return _jbuffer.GetSize();
 			}
+			
+			/**
+			 * \brief Echo the id of the request being answered.
+			 * 
+			 * The JSON is reopened and the member appended rather than the object being
+			 * rebuilt, so this only costs the digits. A binary response has its flag set
+			 * and the id appended.
+			 * 
+			 * \warning Call at most once.
+			 */
+			inline void id(const std::uint64_t value) {
+				if(_encoding == encoding::encoding_t::BINARY) {
+					// The flags follow the magic byte
+					const_cast<char*>(_jbuffer.GetString())[1] |= encoding::_rspnhid;
+					encoding::write_u64(_jbuffer.Push(sizeof(value)), value);
+					return;
+				}
+				
+				char digits[24];
+				const auto length = std::snprintf(digits, sizeof(digits), "%" PRIu64, value);
+				
+				// Drop the closing brace
+				_jbuffer.Pop(1);
+				
+				static const char member[] = ",\"" NET_MIDDLEWARE_RESPONSE_ID_STR "\":";
+				for(std::size_t i = 0; i < sizeof(member) - 1; i++) {
+					_jbuffer.Put(member[i]);
+				}
+				
+				for(int i = 0; i < length; i++) {
+					_jbuffer.Put(digits[i]);
+				}
+				
+				_jbuffer.Put('}');
+			}
 		
 		 private:
 			/**
-			 * \brief This buffer stores our JSON string.
+			 * \brief This buffer stores our encoded response.
+			 */
+			buffer_t _jbuffer;
+			
+			/**
+			 * \brief The encoding of the response.
+			 */
+			encoding::encoding_t _encoding;
+			
+			/**
+			 * \brief Constructor of an empty response in an encoding.
+			 */
+			explicit response(const encoding::encoding_t enc)
+					: _jbuffer(pooled_allocator::shared(),
+						NET_MIDDLEWARE_RESPONSE_CAPACITY),
+					_encoding(enc) {
+			}
+			
+			/**
+			 * \brief Write a response whose result is a single value.
+			 */
+			template <typename T> inline void scalar(const T result, const bool error) {
+				writer_t writer(_jbuffer, pooled_allocator::shared());
+				
+				begin();
+				put(writer, result);
+				end(error);
+			}
+			
+			/**
+			 * \brief Write what comes before the result.
+			 * 
+			 * The flags of a binary response are set by end(), once the error is known.
 			 */
-			::rapidjson::StringBuffer _jbuffer;
+			inline void begin() {
+				if(_encoding == encoding::encoding_t::BINARY) {
+					_jbuffer.Put(static_cast<char>(NET_MIDDLEWARE_BINARY_MAGIC));
+					_jbuffer.Put(0);
+				} else {
+					static const char prefix[] =
+							"{\"" NET_MIDDLEWARE_REQUEST_RESULT_STR "\":";
+					std::memcpy(_jbuffer.Push(sizeof(prefix) - 1),
+							prefix,
+							sizeof(prefix) - 1);
+				}
+			}
+			
+			/**
+			 * \brief Write what comes after the result.
+			 */
+			inline void end(const bool error) {
+				if(_encoding == encoding::encoding_t::BINARY) {
+					if(error) {
+						const_cast<char*>(_jbuffer.GetString())[1] |= encoding::_rspnerr;
+					}
+				} else {
+					static const char suffixFalse[] =
+							",\"" NET_MIDDLEWARE_REQUEST_ERROR_STR "\":false}";
+					static const char suffixTrue[] =
+							",\"" NET_MIDDLEWARE_REQUEST_ERROR_STR "\":true}";
+					
+					if(error) {
+						std::memcpy(_jbuffer.Push(sizeof(suffixTrue) - 1),
+								suffixTrue,
+								sizeof(suffixTrue) - 1);
+					} else {
+						std::memcpy(_jbuffer.Push(sizeof(suffixFalse) - 1),
+								suffixFalse,
+								sizeof(suffixFalse) - 1);
+					}
+				}
+			}
+			
+			/**
+			 * \brief Write a C string value.
+			 */
+			inline void put(writer_t& writer, const char* const value) {
+				if(_encoding == encoding::encoding_t::JSON) {
+					writer.String(value);
+					return;
+				}
+				
+				const auto length = std::strlen(value);
+				
+				binary_tag(encoding::tag_t::STRING);
+				binary_u32(length);
+				std::memcpy(_jbuffer.Push(length + 1), value, length + 1);
+			}
+			
+			/**
+			 * \brief Write a bool value.
+			 */
+			inline void put(writer_t& writer, const bool value) {
+				if(_encoding == encoding::encoding_t::JSON) {
+					writer.Bool(value);
+				} else {
+					binary_tag(value ?
+							encoding::tag_t::BOOL_TRUE : encoding::tag_t::BOOL_FALSE);
+				}
+			}
+			
+			/**
+			 * \brief Write an int value.
+			 */
+			inline void put(writer_t& writer, const int value) {
+				put(writer, static_cast<long long int>(value));
+			}
+			
+			/**
+			 * \brief Write an unsigned int value.
+			 */
+			inline void put(writer_t& writer, const unsigned int value) {
+				put(writer, static_cast<unsigned long long int>(value));
+			}
+			
+			/**
+			 * \brief Write a long int value.
+			 */
+			inline void put(writer_t& writer, const long int value) {
+				put(writer, static_cast<long long int>(value));
+			}
+			
+			/**
+			 * \brief Write an unsigned long int value.
+			 */
+			inline void put(writer_t& writer, const unsigned long int value) {
+				put(writer, static_cast<unsigned long long int>(value));
+			}
+			
+			/**
+			 * \brief Write a long long int value.
+			 */
+			inline void put(writer_t& writer, const long long int value) {
+				if(_encoding == encoding::encoding_t::JSON) {
+					writer.Int64(value);
+				} else {
+					binary_tag(encoding::tag_t::INTEGER);
+					binary_u64(static_cast<std::uint64_t>(value));
+				}
+			}
+			
+			/**
+			 * \brief Write an unsigned long long int value.
+			 */
+			inline void put(writer_t& writer, const unsigned long long int value) {
+				if(_encoding == encoding::encoding_t::JSON) {
+					writer.Uint64(value);
+				} else {
+					binary_tag(encoding::tag_t::UNSIGNED_INTEGER);
+					binary_u64(value);
+				}
+			}
+			
+			/**
+			 * \brief Write a double value.
+			 */
+			inline void put(writer_t& writer, const double value) {
+				if(_encoding == encoding::encoding_t::JSON) {
+					writer.Double(value);
+				} else {
+					std::uint64_t bits;
+					std::memcpy(&bits, &value, sizeof(bits));
+					
+					binary_tag(encoding::tag_t::REAL);
+					binary_u64(bits);
+				}
+			}
 			
 			/**
-			 * \brief Setup a dom.
+			 * \brief Write the tag of a binary value.
 			 */
-			inline ::rapidjson::Document dom_setup() const {
-				::rapidjson::Document dom;
-				dom.SetObject();
-				return dom;
+			inline void binary_tag(const encoding::tag_t tag) {
+				_jbuffer.Put(static_cast<char>(tag));
 			}
 			
 			/**
-			 * \brief Setup a dom for an error response.
+			 * \brief Write a 32-bit unsigned integer of a binary value.
 			 */
-			inline void dom_error(::rapidjson::Document& dom, const bool error) const {
-				dom.AddMember(NET_MIDDLEWARE_REQUEST_ERROR_STR, error, dom.GetAllocator());
+			inline void binary_u32(const std::size_t value) {
+				encoding::write_u32(_jbuffer.Push(sizeof(std::uint32_t)),
+						static_cast<std::uint32_t>(value));
 			}
 			
 			/**
-			 * \brief Turn a dom into a string of json.
+			 * \brief Write a 64-bit unsigned integer of a binary value.
 			 */
-			inline void dom_json(::rapidjson::Document& dom) {
-				::rapidjson::Writer<::rapidjson::StringBuffer> writer(_jbuffer);
-				dom.Accept(writer);
+			inline void binary_u64(const std::uint64_t value) {
+				encoding::write_u64(_jbuffer.Push(sizeof(std::uint64_t)), value);
 			}
 		};
 	}
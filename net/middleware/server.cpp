@@ -1,4 +1,8 @@
 #include "server.hpp"
+#include <buffer/slab_allocator.hpp>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 namespace net {
 	namespace middleware {
@@ -9,9 +13,14 @@ namespace net {
 				oEndpoint{'\0'},
 				isRunning(false),
 				doExit(false),
+				exitEvent(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
 				startupState(0),
 				startupStateTarget(0),
 				workThreads{} {
+			if(UNLIKELY(exitEvent < 0)) {
+				throw std::runtime_error(err_msg::_fdunavl);
+			}
+			
 			auto callback = ::module::module_manager::callback_t<server>{
 					this,
 					&::net::middleware::server::notify
@@ -29,6 +38,8 @@ namespace net {
 			}
 			
 			stop();
+			
+			close(exitEvent);
 		}
 		
 		void server::setup(const char* const iEndpoint,
@@ -60,6 +71,12 @@ namespace net {
 			
 			doExit = true;
 			
+			// Wakes threads blocked in a poll, and stays readable until they have all
+			// exited
+			const std::uint64_t signal = 1;
+			auto result = write(exitEvent, &signal, sizeof(signal));
+			UNUSED(result);
+			
 			for(auto& t : workThreads) {
 				#ifdef THROW
 				try {
@@ -84,6 +101,11 @@ namespace net {
 				#endif
 			}
 			
+			std::uint64_t signals;
+			result = read(exitEvent, &signals, sizeof(signals));
+			UNUSED(result);
+			
+			startupState = 0;
 			doExit = false;
 			isRunning = false;
 		}
@@ -98,27 +120,31 @@ namespace net {
 			
 			moduleAsyncBuffer = &asyncBuffer;
 			
-			if(::actions::check<::actions::actions_t::REQUEST>(supActs) ||
-					::actions::check<::actions::actions_t::PUSH>(supActs)) {
-				#ifdef THROW
-				if(UNLIKELY(iEndpoint[0] == '\0')) {
-					throw std::runtime_error(err_msg::_zrlngth);
-				}
-				#endif
-				
-				workThreads[startupStateTarget++] = std::thread(&server::sync_work, this);
+			const auto doSync = ::actions::check<::actions::actions_t::REQUEST>(supActs) ||
+					::actions::check<::actions::actions_t::PUSH>(supActs);
+			const auto doAsync = ::actions::check<::actions::actions_t::REPLY>(supActs) ||
+					::actions::check<::actions::actions_t::WAIT>(supActs);
+			
+			#ifdef THROW
+			if(UNLIKELY((doSync && iEndpoint[0] == '\0') ||
+					(doAsync && oEndpoint[0] == '\0'))) {
+				throw std::runtime_error(err_msg::_zrlngth);
 			}
-			if(::actions::check<::actions::actions_t::REPLY>(supActs) ||
-					::actions::check<::actions::actions_t::WAIT>(supActs)) {
-				#ifdef THROW
-				if(UNLIKELY(oEndpoint[0] == '\0')) {
-					throw std::runtime_error(err_msg::_zrlngth);
+			#endif
+			
+			if(doSync && doAsync && is_reactor()) {
+				workThreads[startupStateTarget++] = std::thread(&server::reactor_work, this);
+			} else {
+				if(doSync) {
+					workThreads[startupStateTarget++] = std::thread(&server::sync_work, this);
+				}
+				if(doAsync) {
+					workThreads[startupStateTarget++] = std::thread(&server::async_work, this);
 				}
-				#endif
-				
-				workThreads[startupStateTarget++] = std::thread(&server::async_work, this);
 			}
 			
+			isRunning = startupStateTarget != 0;
+			
 			// Wait until launched threads have signaled that they are ready
 			start_lock_t startLock(startMutex);
 			startCV.wait(startLock,
@@ -127,6 +153,40 @@ namespace net {
 					});
 		}
 		
+		void server::report(std::ostream& out) {
+			const auto slabs = ::buffer::slab_allocator::statistics();
+			out << "slab allocator: " << slabs.allocations << " allocations, "
+					<< slabs.deallocations << " deallocations ("
+					<< slabs.remoteDeallocations << " remote), "
+					<< slabs.slabRefills << " slab refills, "
+					<< slabs.heapAllocations << " heap allocations, "
+					<< slabs.arenas << " arenas" << std::endl;
+			
+			out << "module manager: " << moduleManager.expired_count()
+					<< " actions dropped past their deadline" << std::endl;
+			
+			lock_t stateLock(stateMutex);
+			
+			if(moduleAsyncBuffer != NULL) {
+				const auto buffered = moduleAsyncBuffer->statistics();
+				out << "async buffer: " << moduleAsyncBuffer->size() << " items held, "
+						<< buffered.highWaterItems << " items and "
+						<< buffered.highWaterBytes << " bytes at most, "
+						<< buffered.droppedItems << " dropped, "
+						<< buffered.blockedPushes << " blocked pushes, "
+						<< buffered.spilledItems << " spilled ("
+						<< buffered.spillBacklog << " not yet replayed)" << std::endl;
+			}
+		}
+		
+		bool server::is_reactor() const {
+			return false;
+		}
+		
+		void server::reactor_work() {
+			throw std::logic_error(err_msg::_stcimpl);
+		}
+		
 		void server::notify_thread_started() {
 			start_lock_t startLock(startMutex);
 			
@@ -7,6 +7,7 @@
 #include <atomic>
 #include <condition_variable>
 #include <mutex>
+#include <ostream>
 #include <thread>
 
 namespace net {
@@ -81,6 +82,16 @@ namespace net {
 			void setup(const char* const iEndpoint,
 					const char* const oEndpoint);
 			
+			/**
+			 * \brief Initialize the server with a parameter string.
+			 * 
+			 * Parameters are read by the work threads when they start, so this may only
+			 * be called while the server is stopped.
+			 * 
+			 * \warning The implementation of this function must be threadsafe.
+			 */
+			virtual void string_initialize_parameters(const char* const parameters) = 0;
+			
 			/**
 			 * \brief Stop any running server tasks and changes the state to stopped.
 			 *
@@ -126,6 +137,17 @@ namespace net {
 				
 				return isRunning;
 			}
+			
+			/**
+			 * \brief Write the counters kept while serving to a stream, a line for each
+			 * source.
+			 * 
+			 * Called on shutdown so what was counted can be seen. An implementation that
+			 * keeps counters of its own writes them after those of the base.
+			 * 
+			 * \note Threadsafe.
+			 */
+			virtual void report(std::ostream& out);
 		
 		 protected:
 			/**
@@ -138,6 +160,19 @@ namespace net {
 				return doExit;
 			}
 			
+			/**
+			 * \brief Return a file descriptor that polls readable once the server starts
+			 * shutting down.
+			 * 
+			 * Polling this alongside sockets lets a thread block without a timeout and
+			 * still exit as soon as it is asked to.
+			 * 
+			 * \note Threadsafe.
+			 */
+			inline int exit_event() const {
+				return exitEvent;
+			}
+			
 			/**
 			 * \brief Return the endpoint of the incoming sync traffic.
 			 * 
@@ -228,6 +263,11 @@ namespace net {
 			 */
 			std::atomic_bool doExit;
 			
+			/**
+			 * \brief The eventfd signaled alongside doExit.
+			 */
+			int exitEvent;
+			
 			/**
 			 * \brief Mutex protector for the state of the server.
 			 */
@@ -259,7 +299,8 @@ namespace net {
 			/**
 			 * \brief A container for the work threads.
 			 * 
-			 * This can contain a sync listening thread, an async sending thread, or both.
+			 * This can contain a sync listening thread, an async sending thread, both, or
+			 * a single reactor thread doing the work of both.
 			 */
 			std::thread workThreads[2];
 			
@@ -276,6 +317,23 @@ namespace net {
 			 * \warning Implementation must be threadsafe.
 			 */
 			virtual void async_work() = 0;
+			
+			/**
+			 * \brief Return whether or not both sync and async actions are handled in a
+			 * single thread running reactor_work().
+			 * 
+			 * Defaults to false.
+			 */
+			virtual bool is_reactor() const;
+			
+			/**
+			 * \brief Sync action listening and async action sending function that is
+			 * called in a seperate thread in place of both sync_work() and async_work()
+			 * when is_reactor() is true.
+			 * 
+			 * \warning Implementation must be threadsafe.
+			 */
+			virtual void reactor_work();
 		};
 	}
 }
@@ -0,0 +1,37 @@
+#include "token_bucket.hpp"
+#include <algorithm>
+
+namespace net {
+	namespace middleware {
+		token_bucket::token_bucket(const double rate, const double burst)
+				: rate(rate),
+				burst(burst),
+				tokens(burst),
+				lastRefill(steady_clock_t::now()) {
+			if(UNLIKELY(!(rate > 0) || !(burst > 0))) {
+				throw std::invalid_argument(err_msg::_zrlngth);
+			}
+		}
+		
+		token_bucket::~token_bucket() {
+		}
+		
+		bool token_bucket::take() {
+			lock_t lock(tokensMutex);
+			
+			// Read under the lock so time never runs backwards between takes
+			const auto now = steady_clock_t::now();
+			const std::chrono::duration<double> elapsed = now - lastRefill;
+			tokens = std::min(burst, tokens + elapsed.count() * rate);
+			lastRefill = now;
+			
+			if(tokens < 1) {
+				return false;
+			}
+			
+			tokens -= 1;
+			
+			return true;
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#ifndef _NET_MIDDLEWARE_TOKEN_BUCKET_HPP
+#define _NET_MIDDLEWARE_TOKEN_BUCKET_HPP
+
+#include <common.hpp>
+#include <chrono>
+#include <mutex>
+
+namespace net {
+	namespace middleware {
+		/**
+		 * \brief Limits how often something may happen to a sustained rate, while
+		 * allowing bursts up to a size.
+		 * 
+		 * The bucket holds up to burst tokens and refills at rate tokens a second, and
+		 * each admission takes a token. Refilling is computed from the time since the
+		 * last take rather than by a timer.
+		 */
+		class token_bucket {
+		 private:
+			/**
+			 * \brief The clock refills are timed with.
+			 */
+			using steady_clock_t = std::chrono::steady_clock;
+			
+			/**
+			 * \brief Standard mutex lock type for the class.
+			 */
+			using lock_t = std::lock_guard<std::mutex>;
+		
+		 public:
+			/**
+			 * \brief Constructor starts with a full bucket.
+			 * 
+			 * \throws If the rate or burst is zero we throw an invalid_argument.
+			 */
+			token_bucket(const double rate, const double burst);
+			
+			/**
+			 * \brief Copy constructor is disabled.
+			 */
+			token_bucket(const token_bucket&) = delete;
+			
+			/**
+			 * \brief Move constructor is disabled.
+			 */
+			token_bucket(token_bucket&&) = delete;
+			
+			/**
+			 * \brief Assignment operator is disabled.
+			 */
+			token_bucket& operator=(const token_bucket&) = delete;
+			
+			/**
+			 * \brief Move assignment operator is disabled.
+			 */
+			token_bucket& operator=(token_bucket&&) = delete;
+			
+			/**
+			 * \brief Destructor.
+			 */
+			~token_bucket();
+			
+			/**
+			 * \brief Take a token if one is available.
+			 * 
+			 * \note Threadsafe.
+			 * 
+			 * \returns Whether or not a token was taken.
+			 */
+			bool take();
+		
+		 private:
+			/**
+			 * \brief Tokens added a second.
+			 */
+			const double rate;
+			
+			/**
+			 * \brief The most tokens held.
+			 */
+			const double burst;
+			
+			/**
+			 * \brief Tokens held as of lastRefill.
+			 */
+			double tokens;
+			
+			/**
+			 * \brief When tokens was last brought up to date.
+			 */
+			steady_clock_t::time_point lastRefill;
+			
+			/**
+			 * \brief Mutex protector of the tokens.
+			 */
+			std::mutex tokensMutex;
+		};
+	}
+}
+
+#endif
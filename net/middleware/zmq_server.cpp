@@ -1,101 +1,405 @@
 #include "zmq_server.hpp"
+#include <buffer/slab_allocator.hpp>
+#include <boost/bind.hpp>
+#include <boost/program_options.hpp>
+#include <boost/tokenizer.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+#include <vector>
 
 namespace net {
 	namespace middleware {
 		const int zmq_server::sync_send_to;
 		const int zmq_server::sync_receive_to;
+		const int zmq_server::sync_pool_workers;
 		const int zmq_server::async_send_to;
 		const int zmq_server::async_receive_to;
 		const int zmq_server::async_wait_to;
 		const int zmq_server::async_wait_count;
 		const int zmq_server::async_wait_fail;
+		const int zmq_server::async_drain_max;
+		const int zmq_server::async_coalesce_items;
+		const int zmq_server::async_coalesce_bytes;
+		const int zmq_server::busy_poll_idle;
+		const int zmq_server::busy_poll_pause;
+		const int zmq_server::busy_poll_events;
 		
 		zmq_server::zmq_server(::module::module_manager& moduleManager)
-				: server(moduleManager) {
+				: server(moduleManager),
+				syncMode(sync_mode::pair),
+				syncWorkers(sync_pool_workers),
+				reactor(false),
+				coalesceMode(coalesce_mode::none),
+				coalesceItems(async_coalesce_items),
+				coalesceBytes(async_coalesce_bytes),
+				maxInFlight(0),
+				overloadedCount(0),
+				busyPoll(false),
+				busyPollIdle(busy_poll_idle),
+				busyPollPause(busy_poll_pause) {
 		}
 		
 		zmq_server::~zmq_server() {
 		}
 		
+		void zmq_server::string_initialize_parameters(const char* const parameters) {
+			if(UNLIKELY(is_running())) {
+				throw std::logic_error(err_msg::_rsrcbsy);
+			}
+			
+			batch_control::config newBatchConfig;
+			std::string batchMode("fixed");
+			std::string syncModeName("pair");
+			std::size_t newSyncWorkers = sync_pool_workers;
+			bool newReactor = false;
+			std::string coalesceName("none");
+			std::size_t newCoalesceItems = async_coalesce_items;
+			std::size_t newCoalesceBytes = async_coalesce_bytes;
+			std::string cpuList;
+			std::size_t newMaxInFlight = 0;
+			std::string methodRateList;
+			bool newBusyPoll = false;
+			std::size_t newBusyPollIdle = busy_poll_idle;
+			std::size_t newBusyPollPause = busy_poll_pause;
+			
+			try {
+				// Tokenize string
+				std::string tparameters(parameters);
+				boost::escaped_list_separator<char> seperator("\\", "= ", "\"\'");
+				boost::tokenizer<boost::escaped_list_separator<char>> tokens(tparameters, seperator);
+				std::vector<std::string> tokenStrings;
+				std::copy_if(tokens.begin(), tokens.end(), std::back_inserter(tokenStrings), !boost::bind(&std::string::empty, _1));
+				
+				namespace po = boost::program_options;
+				
+				po::options_description desc("Options");
+				desc.add_options()
+					("batch", po::value<std::string>(&batchMode), "async batching [fixed|adaptive]")
+					("batchLatency", po::value<std::size_t>(&newBatchConfig.targetLatency), "adaptive target latency in milliseconds")
+					("batchMax", po::value<std::size_t>(&newBatchConfig.maxBatch), "adaptive largest batch")
+					("sync", po::value<std::string>(&syncModeName), "sync processing [pair|pool]")
+					("syncWorkers", po::value<std::size_t>(&newSyncWorkers), "pool worker threads")
+					("reactor", po::bool_switch(&newReactor), "serve both endpoints from one thread")
+					("cpus", po::value<std::string>(&cpuList), "cpus to pin threads to [n,...]")
+					("coalesce", po::value<std::string>(&coalesceName), "async coalescing [none|multipart|framed]")
+					("coalesceItems", po::value<std::size_t>(&newCoalesceItems), "most items coalesced into a message")
+					("coalesceBytes", po::value<std::size_t>(&newCoalesceBytes), "most data bytes coalesced into a message")
+					("maxInFlight", po::value<std::size_t>(&newMaxInFlight), "pool actions in flight before shedding, 0 for no limit")
+					("methodRate", po::value<std::string>(&methodRateList), "method rate limits [method:rate[:burst],...]")
+					("busyPoll", po::bool_switch(&newBusyPoll), "spin on the sync endpoint rather than block")
+					("busyPollIdle", po::value<std::size_t>(&newBusyPollIdle), "quiet microseconds before busy polling blocks")
+					("busyPollPause", po::value<std::size_t>(&newBusyPollPause), "most cpu relax hints between empty spins");
+				
+				po::variables_map vm;
+				po::store(po::command_line_parser(tokenStrings).options(desc).run(), vm);
+				po::notify(vm);
+			} catch(boost::program_options::error &e) {
+				std::cerr << e.what() << std::endl;
+				exit(-1);
+			}
+			
+			if(batchMode == "fixed") {
+				newBatchConfig.batchMode = batch_control::mode::fixed;
+			} else if(batchMode == "adaptive") {
+				newBatchConfig.batchMode = batch_control::mode::adaptive;
+			} else {
+				throw std::invalid_argument(err_msg::_malinpt);
+			}
+			
+			sync_mode newSyncMode;
+			if(syncModeName == "pair") {
+				newSyncMode = sync_mode::pair;
+			} else if(syncModeName == "pool") {
+				newSyncMode = sync_mode::pool;
+			} else {
+				throw std::invalid_argument(err_msg::_malinpt);
+			}
+			
+			if(UNLIKELY(newSyncWorkers == 0)) {
+				throw std::invalid_argument(err_msg::_zrlngth);
+			}
+			
+			coalesce_mode newCoalesceMode;
+			if(coalesceName == "none") {
+				newCoalesceMode = coalesce_mode::none;
+			} else if(coalesceName == "multipart") {
+				newCoalesceMode = coalesce_mode::multipart;
+			} else if(coalesceName == "framed") {
+				newCoalesceMode = coalesce_mode::framed;
+			} else {
+				throw std::invalid_argument(err_msg::_malinpt);
+			}
+			
+			if(UNLIKELY(newCoalesceItems == 0 || newCoalesceBytes == 0)) {
+				throw std::invalid_argument(err_msg::_zrlngth);
+			}
+			
+			if(UNLIKELY(newReactor && newSyncMode != sync_mode::pair)) {
+				throw std::invalid_argument(err_msg::_unsprtd);
+			}
+			
+			if(UNLIKELY(newMaxInFlight != 0 && newSyncMode != sync_mode::pool)) {
+				throw std::invalid_argument(err_msg::_unsprtd);
+			}
+			
+			// Every worker and the broker of a pool would spin
+			if(UNLIKELY(newBusyPoll && newSyncMode != sync_mode::pair)) {
+				throw std::invalid_argument(err_msg::_unsprtd);
+			}
+			
+			std::vector<unsigned int> newCpus;
+			std::size_t start = 0;
+			while(start < cpuList.size()) {
+				auto end = cpuList.find(',', start);
+				if(end == std::string::npos) {
+					end = cpuList.size();
+				}
+				
+				const auto cpu = std::stoul(cpuList.substr(start, end - start));
+				if(UNLIKELY(cpu >= CPU_SETSIZE)) {
+					throw std::invalid_argument(err_msg::_arybnds);
+				}
+				
+				newCpus.push_back(cpu);
+				start = end + 1;
+			}
+			
+			// Each limit is a method, its rate per second, and optionally its burst, which
+			// is a second's worth by default but at least one
+			std::vector<std::pair<std::string, std::unique_ptr<token_bucket>>> newMethodRates;
+			start = 0;
+			while(start < methodRateList.size()) {
+				auto end = methodRateList.find(',', start);
+				if(end == std::string::npos) {
+					end = methodRateList.size();
+				}
+				
+				const auto limit = methodRateList.substr(start, end - start);
+				const auto rateStart = limit.find(':');
+				if(UNLIKELY(rateStart == std::string::npos || rateStart == 0)) {
+					throw std::invalid_argument(err_msg::_malinpt);
+				}
+				
+				const auto burstStart = limit.find(':', rateStart + 1);
+				const auto rate = std::stod(limit.substr(rateStart + 1,
+						burstStart == std::string::npos ?
+								std::string::npos : burstStart - rateStart - 1));
+				const auto burst = burstStart == std::string::npos ?
+						std::max(rate, 1.0) : std::stod(limit.substr(burstStart + 1));
+				
+				newMethodRates.emplace_back(limit.substr(0, rateStart),
+						std::unique_ptr<token_bucket>(new token_bucket(rate, burst)));
+				start = end + 1;
+			}
+			
+			batchConfig = newBatchConfig;
+			syncMode = newSyncMode;
+			syncWorkers = newSyncWorkers;
+			reactor = newReactor;
+			coalesceMode = newCoalesceMode;
+			coalesceItems = newCoalesceItems;
+			coalesceBytes = newCoalesceBytes;
+			cpus = std::move(newCpus);
+			maxInFlight = newMaxInFlight;
+			methodRates = std::move(newMethodRates);
+			busyPoll = newBusyPoll;
+			busyPollIdle = newBusyPollIdle;
+			busyPollPause = newBusyPollPause;
+		}
+		
 		void zmq_server::sync_work() {
 			try {
-				zmq::socket_t socket(::net::global_zcontext, ZMQ_PAIR);
+				switch(syncMode) {
+				 case sync_mode::pair:
+					sync_pair();
+					break;
+				
+				 case sync_mode::pool:
+					sync_pool();
+					break;
+				}
+			} catch(const zmq::error_t& e) {
+				std::cerr << e.what() << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+		
+		void zmq_server::sync_pair() {
+			pin_thread(0);
+			
+			zmq::socket_t socket(::net::global_zcontext, ZMQ_PAIR);
+			socket.setsockopt(ZMQ_SNDTIMEO, &sync_send_to, sizeof(sync_send_to));
+			socket.setsockopt(ZMQ_RCVTIMEO, &sync_receive_to, sizeof(sync_receive_to));
+			socket.bind(get_iEndpoint());
+			
+			notify_thread_started();
+			
+			react(&socket, NULL);
+			
+			socket.unbind(get_iEndpoint());
+			socket.close();
+		}
+		
+		void zmq_server::sync_pool() {
+			pin_thread(0);
+			
+			// Unique to this server so several may run in one process
+			const std::string backendEndpoint("inproc://af-sync-pool-" +
+					std::to_string(reinterpret_cast<std::uintptr_t>(this)));
+			
+			zmq::socket_t frontend(::net::global_zcontext, ZMQ_ROUTER);
+			frontend.setsockopt(ZMQ_SNDTIMEO, &sync_send_to, sizeof(sync_send_to));
+			frontend.bind(get_iEndpoint());
+			
+			// An inproc endpoint must be bound before the workers connect to it
+			zmq::socket_t backend(::net::global_zcontext, ZMQ_ROUTER);
+			backend.setsockopt(ZMQ_SNDTIMEO, &sync_send_to, sizeof(sync_send_to));
+			backend.bind(backendEndpoint.c_str());
+			
+			std::vector<std::thread> workers;
+			for(std::size_t i = 0; i < syncWorkers; i++) {
+				workers.emplace_back(&zmq_server::sync_pool_work, this, backendEndpoint, i + 2);
+			}
+			
+			notify_thread_started();
+			
+			// Identities of the workers waiting for an action, each of which asked for
+			// one when it started and again with each response
+			std::deque<std::string> idleWorkers;
+			std::size_t busyWorkers = 0;
+			
+			// Messages of actions taken in while limiting the actions in flight, waiting
+			// for a worker
+			std::deque<std::vector<zmq::message_t>> pending;
+			std::vector<zmq::message_t> envelope;
+			
+			zmq::pollitem_t items[] = {
+				{static_cast<void*>(backend), 0, ZMQ_POLLIN, 0},
+				{NULL, exit_event(), ZMQ_POLLIN, 0},
+				{static_cast<void*>(frontend), 0, ZMQ_POLLIN, 0}
+			};
+			
+			while(!do_exit()) {
+				// Without a limit, actions are left queued in the frontend until a worker
+				// is idle, so an action never waits behind a slow one while another worker
+				// is free. With one, they are taken in as they arrive so those over it are
+				// answered at once rather than left to time out.
+				const auto takeActions = maxInFlight != 0 || !idleWorkers.empty();
+				zmq::poll(items, takeActions ? 3 : 2, -1);
+				
+				if(items[0].revents & ZMQ_POLLIN) {
+					zmq::message_t worker;
+					zmq::message_t delimiter;
+					zmq::message_t first;
+					backend.recv(&worker);
+					backend.recv(&delimiter);
+					backend.recv(&first);
+					
+					idleWorkers.emplace_back(static_cast<char*>(worker.data()),
+							worker.size());
+					
+					if(has_more(backend)) {
+						// A response, which begins with the envelope of the client, and
+						// not a worker announcing itself
+						busyWorkers--;
+						frontend.send(first, ZMQ_SNDMORE);
+						forward(backend, frontend);
+					}
+				}
+				
+				if(takeActions && (items[2].revents & ZMQ_POLLIN)) {
+					if(maxInFlight == 0) {
+						// Address the worker in front of the envelope of the client, which
+						// the worker hands back with the response
+						const auto& worker = idleWorkers.front();
+						backend.send(worker.data(), worker.size(), ZMQ_SNDMORE);
+						backend.send("", 0, ZMQ_SNDMORE);
+						forward(frontend, backend);
+						
+						idleWorkers.pop_front();
+						busyWorkers++;
+					} else if(pending.size() + busyWorkers >= maxInFlight) {
+						zmq::message_t rcvMsg;
+						frontend.recv(&rcvMsg);
+						answer_routed(frontend, rcvMsg, envelope, true);
+					} else {
+						pending.emplace_back();
+						do {
+							pending.back().emplace_back();
+							frontend.recv(&pending.back().back());
+						} while(has_more(frontend));
+					}
+				}
+				
+				while(!idleWorkers.empty() && !pending.empty()) {
+					const auto& worker = idleWorkers.front();
+					backend.send(worker.data(), worker.size(), ZMQ_SNDMORE);
+					backend.send("", 0, ZMQ_SNDMORE);
+					
+					auto& parts = pending.front();
+					for(std::size_t i = 0; i < parts.size(); i++) {
+						backend.send(parts[i], i + 1 < parts.size() ? ZMQ_SNDMORE : 0);
+					}
+					
+					pending.pop_front();
+					idleWorkers.pop_front();
+					busyWorkers++;
+				}
+				
+				items[2].revents = 0;
+			}
+			
+			// Workers are woken by the exit event too
+			for(auto& worker : workers) {
+				worker.join();
+			}
+			
+			backend.unbind(backendEndpoint.c_str());
+			backend.close();
+			frontend.unbind(get_iEndpoint());
+			frontend.close();
+		}
+		
+		void zmq_server::sync_pool_work(const std::string backendEndpoint,
+				const std::size_t slot) {
+			try {
+				pin_thread(slot);
+				
+				zmq::socket_t socket(::net::global_zcontext, ZMQ_REQ);
 				socket.setsockopt(ZMQ_SNDTIMEO, &sync_send_to, sizeof(sync_send_to));
 				socket.setsockopt(ZMQ_RCVTIMEO, &sync_receive_to, sizeof(sync_receive_to));
-				socket.bind(get_iEndpoint());
+				socket.connect(backendEndpoint.c_str());
 				
-				notify_thread_started();
+				// Ask for the first action
+				socket.send(::zmq::message_t());
+				
+				std::vector<::zmq::message_t> envelope;
+				
+				zmq::pollitem_t items[] = {
+					{static_cast<void*>(socket), 0, ZMQ_POLLIN, 0},
+					{NULL, exit_event(), ZMQ_POLLIN, 0}
+				};
 				
 				while(!do_exit()) {
+					// Block until we receive a message or are asked to exit
+					zmq::poll(items, 2, -1);
+					
 					zmq::message_t rcvMsg;
-					// Block until we receive a message or timeout
-					if(socket.recv(&rcvMsg)) {
-						#ifdef THROW
-						// Check that we can do insitu parsing
-						if(static_cast<char*>(rcvMsg.data())[rcvMsg.size()-1] != '\0') {
-							throw std::runtime_error(err_msg::_malinpt);
-						}
-						#endif
-						
-						const request rqst(rcvMsg.data());
-						response* rspns = NULL;
-						
-						switch(rqst.action()) {
-						 case ::actions::actions_t::REQUEST:
-							/**  \todo Make this catch more specific. */
-							try {
-								rspns = module_manager().proc_act_request(rqst);
-							} catch(const std::exception& e) {
-								rspns = new response(e.what(), true);
-							}
-							break;
-						
-						 case ::actions::actions_t::PUSH:
-							/**  \todo Make this catch more specific. */
-							try {
-								rspns = new response(module_manager().proc_act_push(rqst));
-							} catch(const std::exception& e) {
-								rspns = new response(e.what(), true);
-							}
-							break;
-						
-						 case ::actions::actions_t::WAIT:
-						 case ::actions::actions_t::REPLY:
-							#ifdef THROW
-							throw std::runtime_error(err_msg::_malinpt);
-							#endif
-							
-							continue;
-						}
-						
-						#ifdef THROW
-						if(UNLIKELY(rspns == NULL)) {
-							throw std::runtime_error(err_msg::_nllpntr);
-						}
-						#endif
-						
-						// This conforms to the requirement imposed by zmq::message_t
-						// zero-copy idiom that passes a pointer to the data along
-						// with a hint object. Because our data is within the hint
-						// object, we just deallocate the hint object, which is our
-						// case is a response object. The use of the idiom ensures we
-						// do not copy the data of a request in zmq and rather we tell
-						// zmq the buffer is safe to use until the message is sent.
-						// This function is then called automatically to delete the
-						// request object.
-						auto voidHelper = static_cast<const void*>(rspns->json());
-						socket.send(::zmq::message_t(const_cast<void*>(voidHelper),
-								rspns->size(),
-								// Capture nothing
-								[] (void* data, void* hint) {
-									UNUSED(data);
-									delete static_cast<response*>(hint);
-								},
-								rspns));
+					if(!(items[0].revents & ZMQ_POLLIN) ||
+							!socket.recv(&rcvMsg, ZMQ_DONTWAIT)) {
+						continue;
 					}
+					
+					// A REQ socket must answer every request before it can receive the
+					// next, and the answer asks for the next action
+					answer_routed(socket, rcvMsg, envelope, false);
 				}
 				
-				socket.unbind(get_iEndpoint());
 				socket.close();
 			} catch(const zmq::error_t& e) {
 				std::cerr << e.what() << std::endl;
@@ -103,68 +407,680 @@ namespace net {
 			}
 		}
 		
+		void zmq_server::answer_routed(::zmq::socket_t& socket,
+				::zmq::message_t& rcvMsg,
+				std::vector<::zmq::message_t>& envelope,
+				const bool shed) {
+			// Every frame up to and including the empty delimiter addresses the client,
+			// and the actions follow
+			envelope.clear();
+			while(has_more(socket)) {
+				const auto isDelimiter = rcvMsg.size() == 0;
+				envelope.push_back(std::move(rcvMsg));
+				socket.recv(&rcvMsg);
+				
+				if(isDelimiter) {
+					break;
+				}
+			}
+			
+			for(auto& part : envelope) {
+				socket.send(part, ZMQ_SNDMORE);
+			}
+			
+			answer(socket, rcvMsg, true, shed);
+		}
+		
+		void zmq_server::answer(::zmq::socket_t& socket,
+				::zmq::message_t& rcvMsg,
+				const bool mustAnswer,
+				const bool shed) {
+			if(LIKELY(!has_more(socket))) {
+				auto rspns = process(rcvMsg, mustAnswer, shed);
+				
+				if(rspns != NULL) {
+					send_response(socket, rspns);
+				}
+				
+				return;
+			}
+			
+			// Each frame of a multipart message is an action of one batch
+			std::vector<::zmq::message_t> frames;
+			frames.push_back(std::move(rcvMsg));
+			do {
+				frames.emplace_back();
+				socket.recv(&frames.back());
+			} while(has_more(socket));
+			
+			std::vector<request> requests;
+			std::vector<bool> decoded(frames.size());
+			requests.reserve(frames.size());
+			for(std::size_t i = 0; i < frames.size(); i++) {
+				bool frameDecoded;
+				requests.emplace_back(static_cast<char*>(frames[i].data()),
+						frames[i].size(),
+						frameDecoded);
+				
+				if(UNLIKELY(!frameDecoded)) {
+					requests.pop_back();
+				}
+				
+				decoded[i] = frameDecoded;
+			}
+			
+			std::vector<response*> responses;
+			if(LIKELY(!requests.empty())) {
+				process_batch(requests, responses, shed);
+			}
+			
+			if(UNLIKELY(requests.size() != frames.size())) {
+				// Malformed frames are answered in their place
+				std::vector<response*> decodedResponses;
+				decodedResponses.swap(responses);
+				
+				std::size_t next = 0;
+				for(std::size_t i = 0; i < frames.size(); i++) {
+					responses.push_back(decoded[i] ?
+							decodedResponses[next++] :
+							new response(err_msg::_malinpt,
+								true,
+								encoding::of(frames[i].data(), frames[i].size())));
+				}
+			}
+			
+			// Answered with a frame for each action, in order
+			auto sent = true;
+			for(std::size_t i = 0; i < responses.size(); i++) {
+				if(LIKELY(sent)) {
+					sent = send_response(socket,
+							responses[i],
+							i + 1 < responses.size() ? ZMQ_SNDMORE : 0);
+				} else {
+					delete responses[i];
+				}
+			}
+		}
+		
+		response* zmq_server::process(::zmq::message_t& rcvMsg,
+				const bool mustAnswer,
+				const bool shed) {
+			auto input = insitu(rcvMsg);
+			
+			if(UNLIKELY(input == NULL)) {
+				return new response(err_msg::_malinpt, true);
+			}
+			
+			if(UNLIKELY(is_batch(input))) {
+				// The actions of a JSON array are decoded in a single pass and are
+				// answered with a JSON array
+				std::vector<request> requests;
+				
+				if(UNLIKELY(!request::decode_batch(input, requests))) {
+					return new response(err_msg::_malinpt, true);
+				}
+				
+				std::vector<response*> responses;
+				process_batch(requests, responses, shed);
+				
+				return new response(responses);
+			}
+			
+			bool decoded;
+			const request rqst(input, rcvMsg.size(), decoded);
+			response* rspns = NULL;
+			
+			if(UNLIKELY(!decoded)) {
+				return new response(err_msg::_malinpt,
+						true,
+						encoding::of(input, rcvMsg.size()));
+			}
+			
+			// Dropped before admission so it takes no share of the rate of its method
+			if(UNLIKELY(rqst.expired())) {
+				module_manager().count_expired();
+				rspns = new response(err_msg::_dlnexpd, true, rqst.encoding());
+				
+				if(rqst.has_id()) {
+					rspns->id(rqst.id());
+				}
+				
+				return rspns;
+			}
+			
+			if(UNLIKELY(!admit(rqst, shed))) {
+				rspns = new response(err_msg::_ovrldd, true, rqst.encoding());
+				
+				if(rqst.has_id()) {
+					rspns->id(rqst.id());
+				}
+				
+				return rspns;
+			}
+			
+			switch(rqst.action()) {
+			 case ::actions::actions_t::REQUEST:
+				/**  \todo Make this catch more specific. */
+				try {
+					rspns = module_manager().proc_act_request(rqst);
+				} catch(const std::exception& e) {
+					rspns = new response(e.what(), true, rqst.encoding());
+				}
+				break;
+			
+			 case ::actions::actions_t::PUSH:
+				/**  \todo Make this catch more specific. */
+				try {
+					rspns = new response(module_manager().proc_act_push(rqst),
+							false,
+							rqst.encoding());
+				} catch(const std::exception& e) {
+					rspns = new response(e.what(), true, rqst.encoding());
+				}
+				break;
+			
+			 case ::actions::actions_t::WAIT:
+			 case ::actions::actions_t::REPLY:
+				// Any client may send these, so they are answered rather than thrown
+				if(!mustAnswer) {
+					return NULL;
+				}
+				
+				rspns = new response(err_msg::_malinpt, true, rqst.encoding());
+				break;
+			}
+			
+			#ifdef THROW
+			if(UNLIKELY(rspns == NULL)) {
+				throw std::runtime_error(err_msg::_nllpntr);
+			}
+			#endif
+			
+			if(rqst.has_id()) {
+				rspns->id(rqst.id());
+			}
+			
+			return rspns;
+		}
+		
+		void zmq_server::process_batch(std::vector<request>& requests,
+				std::vector<response*>& responses,
+				const bool shed) {
+			std::vector<bool> admitted;
+			std::vector<bool> expired;
+			admitted.reserve(requests.size());
+			expired.reserve(requests.size());
+			for(const auto& rqst : requests) {
+				// Dropped before admission so they take no share of the rate of a method
+				expired.push_back(rqst.expired());
+				if(UNLIKELY(expired.back())) {
+					module_manager().count_expired();
+				}
+				
+				admitted.push_back(!expired.back() && admit(rqst, shed));
+			}
+			
+			if(LIKELY(std::find(admitted.begin(), admitted.end(), false) == admitted.end())) {
+				module_batch(requests, responses);
+			} else {
+				// Only the admitted actions reach the module manager, and the others are
+				// answered in their place as expired or overloaded
+				std::vector<request> admittedRequests;
+				for(std::size_t i = 0; i < requests.size(); i++) {
+					if(admitted[i]) {
+						admittedRequests.push_back(std::move(requests[i]));
+					}
+				}
+				
+				std::vector<response*> admittedResponses;
+				if(!admittedRequests.empty()) {
+					module_batch(admittedRequests, admittedResponses);
+				}
+				
+				std::size_t next = 0;
+				for(std::size_t i = 0; i < requests.size(); i++) {
+					responses.push_back(admitted[i] ?
+							admittedResponses[next++] :
+							new response(expired[i] ? err_msg::_dlnexpd : err_msg::_ovrldd,
+								true,
+								requests[i].encoding()));
+				}
+			}
+			
+			// A request that was moved from keeps its id
+			for(std::size_t i = 0; i < requests.size(); i++) {
+				if(requests[i].has_id()) {
+					responses[i]->id(requests[i].id());
+				}
+			}
+		}
+		
+		void zmq_server::module_batch(const std::vector<request>& requests,
+				std::vector<response*>& responses) {
+			/**  \todo Make this catch more specific. */
+			try {
+				module_manager().proc_act_batch(requests, responses);
+			} catch(const std::exception& e) {
+				// Nothing was processed, so every action gets the error
+				for(auto rspns : responses) {
+					delete rspns;
+				}
+				
+				responses.clear();
+				for(std::size_t i = 0; i < requests.size(); i++) {
+					responses.push_back(new response(e.what(),
+							true,
+							requests[i].encoding()));
+				}
+			}
+		}
+		
+		bool zmq_server::admit(const request& rqst, const bool shed) {
+			if(LIKELY(!shed)) {
+				if(LIKELY(methodRates.empty())) {
+					return true;
+				}
+				
+				// Only requests and pushes name a method
+				if(rqst.action() != ::actions::actions_t::REQUEST &&
+						rqst.action() != ::actions::actions_t::PUSH) {
+					return true;
+				}
+				
+				const auto method = rqst.method();
+				auto limited = false;
+				for(const auto& methodRate : methodRates) {
+					if(methodRate.first == method) {
+						limited = !methodRate.second->take();
+						break;
+					}
+				}
+				
+				if(LIKELY(!limited)) {
+					return true;
+				}
+			}
+			
+			overloadedCount.fetch_add(1, std::memory_order_relaxed);
+			
+			return false;
+		}
+		
+		bool zmq_server::send_response(::zmq::socket_t& socket,
+				response* const rspns,
+				const int flags) {
+			// This conforms to the requirement imposed by zmq::message_t zero-copy
+			// idiom that passes a pointer to the data along with a hint object. Because
+			// our data is within the hint object, we just deallocate the hint object,
+			// which is our case is a response object. The use of the idiom ensures we do
+			// not copy the data of a request in zmq and rather we tell zmq the buffer is
+			// safe to use until the message is sent. This function is then called
+			// automatically to delete the request object.
+			auto voidHelper = static_cast<const void*>(rspns->data());
+			return socket.send(::zmq::message_t(const_cast<void*>(voidHelper),
+					rspns->size(),
+					// Capture nothing
+					[] (void* data, void* hint) {
+						UNUSED(data);
+						delete static_cast<response*>(hint);
+					},
+					rspns),
+					flags);
+		}
+		
+		void zmq_server::forward(::zmq::socket_t& from, ::zmq::socket_t& to) {
+			bool more;
+			do {
+				zmq::message_t part;
+				if(!from.recv(&part)) {
+					return;
+				}
+				
+				more = has_more(from);
+				to.send(part, more ? ZMQ_SNDMORE : 0);
+			} while(more);
+		}
+		
+		bool zmq_server::has_more(::zmq::socket_t& socket) {
+			int more;
+			auto moreSize = sizeof(more);
+			socket.getsockopt(ZMQ_RCVMORE, &more, &moreSize);
+			
+			return more != 0;
+		}
+		
+		char* zmq_server::insitu(::zmq::message_t& msg) {
+			// Check that we can do insitu parsing, which binary messages do not need
+			if(encoding::of(msg.data(), msg.size()) == encoding::encoding_t::JSON &&
+					(msg.size() == 0 ||
+					static_cast<char*>(msg.data())[msg.size()-1] != '\0')) {
+				return NULL;
+			}
+			
+			return static_cast<char*>(msg.data());
+		}
+		
+		bool zmq_server::is_batch(const char* input) {
+			while(*input == ' ' || *input == '\t' || *input == '\n' || *input == '\r') {
+				input++;
+			}
+			
+			return *input == '[';
+		}
+		
 		void zmq_server::async_work() {
 			try {
+				pin_thread(1);
+				
 				zmq::socket_t socket(::net::global_zcontext, ZMQ_PAIR);
 				socket.setsockopt(ZMQ_SNDTIMEO, &async_send_to, sizeof(async_send_to));
 				socket.setsockopt(ZMQ_SNDTIMEO, &async_send_to, sizeof(async_receive_to));
 				socket.bind(get_oEndpoint());
 				
-				auto& asyncBuffer = module_async_buffer();
+				notify_thread_started();
+				
+				react(NULL, &socket);
+				
+				socket.unbind(get_oEndpoint());
+				socket.close();
+			} catch(const zmq::error_t& e) {
+				std::cerr << e.what() << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+		
+		void zmq_server::report(std::ostream& out) {
+			server::report(out);
+			
+			out << "input endpoint: " << overloaded_count()
+					<< " actions answered as overloaded" << std::endl;
+		}
+		
+		bool zmq_server::is_reactor() const {
+			return reactor;
+		}
+		
+		void zmq_server::reactor_work() {
+			try {
+				pin_thread(0);
+				
+				zmq::socket_t syncSocket(::net::global_zcontext, ZMQ_PAIR);
+				syncSocket.setsockopt(ZMQ_SNDTIMEO, &sync_send_to, sizeof(sync_send_to));
+				syncSocket.setsockopt(ZMQ_RCVTIMEO, &sync_receive_to, sizeof(sync_receive_to));
+				syncSocket.bind(get_iEndpoint());
 				
-				asyncBuffer.set_push_wait_threshold(async_wait_count);
-				std::size_t failCount = 0;
+				zmq::socket_t asyncSocket(::net::global_zcontext, ZMQ_PAIR);
+				asyncSocket.setsockopt(ZMQ_SNDTIMEO, &async_send_to, sizeof(async_send_to));
+				asyncSocket.bind(get_oEndpoint());
 				
 				notify_thread_started();
 				
-				while(!do_exit()) {
-					if(asyncBuffer.push_wait(async_wait_to)
-							|| ++failCount == async_wait_fail) {
+				react(&syncSocket, &asyncSocket);
+				
+				asyncSocket.unbind(get_oEndpoint());
+				asyncSocket.close();
+				syncSocket.unbind(get_iEndpoint());
+				syncSocket.close();
+			} catch(const zmq::error_t& e) {
+				std::cerr << e.what() << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+		
+		void zmq_server::react(::zmq::socket_t* const syncSocket,
+				::zmq::socket_t* const asyncSocket) {
+			auto asyncBuffer = asyncSocket != NULL ? &module_async_buffer() : NULL;
+			
+			batch_control batching(batchConfig,
+					async_wait_count,
+					async_wait_to,
+					async_wait_fail);
+			
+			std::vector<::buffer::buffer_item> localBuffer;
+			std::string frame;
+			
+			zmq::pollitem_t items[3];
+			std::size_t itemCount = 0;
+			items[itemCount++] = {NULL, exit_event(), ZMQ_POLLIN, 0};
+			
+			const auto syncItem = itemCount;
+			if(syncSocket != NULL) {
+				items[itemCount++] = {static_cast<void*>(*syncSocket), 0, ZMQ_POLLIN, 0};
+			}
+			
+			const auto asyncItem = itemCount;
+			if(asyncSocket != NULL) {
+				items[itemCount++] = {NULL, asyncBuffer->push_event(), ZMQ_POLLIN, 0};
+				
+				asyncBuffer->set_push_wait_threshold(batching.batch());
+				localBuffer.reserve(async_drain_max);
+				
+				if(coalesceMode == coalesce_mode::framed) {
+					frame.reserve(coalesceBytes);
+				}
+			}
+			
+			// Items waiting for a batch to fill are sent once the batch wait has passed
+			// the fail limit number of times
+			auto waiting = false;
+			std::size_t failCount = 0;
+			auto tick = std::chrono::steady_clock::now();
+			
+			// Busy polling spins until the sockets have been quiet for the idle period
+			const std::chrono::microseconds idle(busyPollIdle);
+			auto lastActive = std::chrono::steady_clock::now();
+			std::size_t spins = 0;
+			std::size_t pause = 0;
+			
+			while(!do_exit()) {
+				long timeout = -1;
+				
+				// With nothing buffered there is no batch to time out on, so sleep until
+				// the next push and send it straight away
+				if(asyncSocket != NULL && !asyncBuffer->arm_push_event()) {
+					const auto now = std::chrono::steady_clock::now();
+					if(!waiting) {
+						waiting = true;
+						tick = now + std::chrono::milliseconds(batching.wait());
+					}
+					
+					timeout = tick > now ?
+							std::chrono::duration_cast<std::chrono::milliseconds>(
+									tick - now).count() + 1 :
+							0;
+				} else {
+					waiting = false;
+					failCount = 0;
+				}
+				
+				const auto spinning = busyPoll &&
+						std::chrono::steady_clock::now() - lastActive < idle;
+				
+				if(LIKELY(!spinning)) {
+					// Block until something is ready, we are asked to exit, or the batch
+					// wait passes
+					zmq::poll(items, itemCount, timeout);
+				} else if(++spins % busy_poll_events == 0) {
+					zmq::poll(items, itemCount, 0);
+				} else {
+					for(std::size_t i = 0; i < itemCount; i++) {
+						items[i].revents = 0;
+					}
+				}
+				
+				auto active = false;
+				
+				// A spin tries the socket whether or not it was polled
+				if(syncSocket != NULL &&
+						(spinning || (items[syncItem].revents & ZMQ_POLLIN))) {
+					zmq::message_t rcvMsg;
+					if(syncSocket->recv(&rcvMsg, ZMQ_DONTWAIT)) {
+						answer(*syncSocket, rcvMsg, false, false);
+						active = true;
+					}
+				}
+				
+				if(asyncSocket != NULL) {
+					auto drain = false;
+					
+					if(items[asyncItem].revents & ZMQ_POLLIN) {
+						asyncBuffer->clear_push_event();
+						drain = true;
+					} else if(waiting && std::chrono::steady_clock::now() >= tick) {
+						tick += std::chrono::milliseconds(batching.wait());
+						drain = ++failCount >= batching.fail_limit();
+					}
+					
+					if(drain) {
+						waiting = false;
 						failCount = 0;
+						send_async(*asyncSocket,
+								*asyncBuffer,
+								batching,
+								localBuffer,
+								frame);
+						active = true;
+					}
+				}
+				
+				if(busyPoll) {
+					if(active) {
+						// Spin flat out again, or start spinning after a quiet period
+						lastActive = std::chrono::steady_clock::now();
+						pause = 0;
+					} else if(spinning) {
+						for(std::size_t i = 0; i < pause; i++) {
+							CPU_RELAX();
+						}
 						
-						auto&& localBuffer = asyncBuffer.pop_all();
+						pause = std::min(pause * 2 + 1, busyPollPause);
+					}
+				}
+			}
+		}
+		
+		void zmq_server::send_async(::zmq::socket_t& socket,
+				::buffer::queue_buffer& asyncBuffer,
+				batch_control& batching,
+				std::vector<::buffer::buffer_item>& localBuffer,
+				std::string& frame) {
+			std::size_t drained = 0;
+			
+			// Items are coalesced across drains, so the last frame of a multipart
+			// message is held back until we know whether another follows it
+			::zmq::message_t held;
+			auto holding = false;
+			std::size_t groupItems = 0;
+			std::size_t groupBytes = 0;
+			
+			while(!do_exit() && asyncBuffer.pop_into(localBuffer, async_drain_max) != 0) {
+				drained += localBuffer.size();
+				
+				for(auto& item : localBuffer) {
+					const auto size = item.size();
+					
+					switch(coalesceMode) {
+					 case coalesce_mode::none:
+						socket.send(item_message(item));
+						break;
+					
+					 case coalesce_mode::multipart:
+						if(holding) {
+							socket.send(held, ZMQ_SNDMORE);
+						}
 						
-						while(localBuffer.size() != 0) {
-							using namespace ::buffer;
+						held = item_message(item);
+						holding = true;
+						groupBytes += size;
+						
+						if(++groupItems >= coalesceItems || groupBytes >= coalesceBytes) {
+							socket.send(held);
+							holding = false;
+							groupItems = 0;
+							groupBytes = 0;
+						}
+						break;
+					
+					 case coalesce_mode::framed:
+						{
+							if(!frame.empty() &&
+									frame.size() + sizeof(std::uint32_t) + size > coalesceBytes) {
+								socket.send(::zmq::message_t(frame.data(), frame.size()));
+								frame.clear();
+								groupItems = 0;
+							}
 							
-							// This is to get around an oversight in the C++11 standard
-							// where our std::queue cannot get an item from the queue by
-							// move, only by reference. This is safe because this we hold
-							// the only copy of this queue so we know nothing will change
-							// between front() and pop().
-							auto& tempRef = const_cast<buffer_item&>(localBuffer.front());
-							auto rspns = new buffer_item(std::move(tempRef));
-							localBuffer.pop();
+							const std::uint32_t length =
+									HTN_BYTE_ORD(static_cast<std::uint32_t>(size));
+							frame.append(reinterpret_cast<const char*>(&length),
+									sizeof(length));
+							frame.append(item.data(), size);
 							
-							// This conforms to the requirement imposed by zmq::message_t
-							// zero-copy idiom that passes a pointer to the data along
-							// with a hint object. Because our data is within the hint
-							// object, we just deallocate the hint object, which is our
-							// case is a response object. The use of the idiom ensures we
-							// do not copy the data of a request in zmq and rather we tell
-							// zmq the buffer is safe to use until the message is sent.
-							// This function is then called automatically to delete the
-							// request object.
-							auto voidHelper = static_cast<const void*>(rspns->data());
-							socket.send(::zmq::message_t(const_cast<void*>(voidHelper),
-									rspns->size(),
-									// Capture nothing
-									[] (void* data, void* hint) {
-										UNUSED(data);
-										delete static_cast<buffer_item*>(hint);
-									},
-									rspns));
-						
+							if(++groupItems >= coalesceItems) {
+								socket.send(::zmq::message_t(frame.data(), frame.size()));
+								frame.clear();
+								groupItems = 0;
+							}
 						}
+						break;
 					}
 				}
 				
-				socket.unbind(get_oEndpoint());
-				socket.close();
-			} catch(const zmq::error_t& e) {
-				std::cerr << e.what() << std::endl;
-				exit(EXIT_FAILURE);
+				// Keeps the capacity for the next drain
+				localBuffer.clear();
+			}
+			
+			if(holding) {
+				socket.send(held);
+			}
+			
+			if(!frame.empty()) {
+				socket.send(::zmq::message_t(frame.data(), frame.size()));
+				frame.clear();
+			}
+			
+			if(batching.record_drain(drained)) {
+				asyncBuffer.set_push_wait_threshold(batching.batch());
+			}
+		}
+		
+		::zmq::message_t zmq_server::item_message(::buffer::buffer_item& item) {
+			if(item.is_message()) {
+				// The item adopted the message it was received in, so forward that
+				// message as is
+				return std::move(item.message());
+			}
+			
+			if(item.data() == 0) {
+				return ::zmq::message_t();
+			}
+			
+			// This conforms to the requirement imposed by zmq::message_t zero-copy idiom
+			// that passes a pointer to the data along with a function to free it. The
+			// item gives up its payload, which zmq then owns until the message is sent,
+			// at which point this function is called automatically to give the payload
+			// back to the slab allocator.
+			const auto size = item.size();
+			return ::zmq::message_t(item.release_data(),
+					size,
+					// Capture nothing
+					[] (void* data, void* hint) {
+						UNUSED(hint);
+						::buffer::slab_allocator::deallocate(static_cast<char*>(data));
+					});
+		}
+		
+		void zmq_server::pin_thread(const std::size_t slot) {
+			if(cpus.empty()) {
+				return;
 			}
+			
+			cpu_set_t cpuSet;
+			CPU_ZERO(&cpuSet);
+			CPU_SET(cpus[slot % cpus.size()], &cpuSet);
+			
+			// Best effort, an unpinned thread still works
+			pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet);
 		}
 	}
 }
@@ -2,10 +2,18 @@
 #define _NET_MIDDLEWARE_ZMQ_SERVER_HPP
 
 #include <common.hpp>
+#include "batch_control.hpp"
 #include "server.hpp"
 #include "request.hpp"
 #include "response.hpp"
+#include "token_bucket.hpp"
 #include <cppzmq/zmq.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace net {
 	namespace middleware {
@@ -14,6 +22,43 @@ namespace net {
 		 */
 		class zmq_server : public server {
 		 public:
+			/**
+			 * \brief How the input endpoint processes actions.
+			 */
+			enum class sync_mode {
+				/**
+				 * \brief A single thread serves one client over a PAIR socket.
+				 */
+				pair,
+				
+				/**
+				 * \brief A ROUTER socket shares the actions of any number of clients
+				 * among a pool of worker threads.
+				 */
+				pool
+			};
+			
+			/**
+			 * \brief How the output endpoint packs items into messages.
+			 */
+			enum class coalesce_mode {
+				/**
+				 * \brief Each item is a message of its own.
+				 */
+				none,
+				
+				/**
+				 * \brief Each item is a frame of a multipart message.
+				 */
+				multipart,
+				
+				/**
+				 * \brief Items are copied into a single frame, each preceded by its length
+				 * as a 4 byte big endian unsigned integer.
+				 */
+				framed
+			};
+			
 			/**
 			 * \brief Constructor takes a mutable reference to a module manager.
 			 * 
@@ -47,15 +92,131 @@ namespace net {
 			 * \brief Destructor cleans up resources allocated in this child.
 			 */
 			virtual ~zmq_server();
+			
+			/**
+			 * \brief Initialize the server with a parameter string.
+			 * 
+			 * \note Threadsafe.
+			 * 
+			 * \throws If the server is running we throw a logic_error. If a parameter is
+			 * malformed we throw an invalid_argument.
+			 */
+			void string_initialize_parameters(const char* const parameters);
+			
+			/**
+			 * \brief Return the number of actions answered as overloaded rather than
+			 * processed.
+			 * 
+			 * \note Threadsafe.
+			 */
+			inline std::uint64_t overloaded_count() const {
+				return overloadedCount.load(std::memory_order_relaxed);
+			}
+			
+			/**
+			 * \brief Write the counters of the base, then the overloaded count, to a
+			 * stream.
+			 * 
+			 * \note Threadsafe.
+			 */
+			void report(std::ostream& out);
 		
 		 private:
+			/**
+			 * \brief How the async sender batches items.
+			 */
+			batch_control::config batchConfig;
+			
+			/**
+			 * \brief How the input endpoint processes actions.
+			 */
+			sync_mode syncMode;
+			
+			/**
+			 * \brief The number of worker threads processing actions in pool mode.
+			 */
+			std::size_t syncWorkers;
+			
+			/**
+			 * \brief Whether or not a single thread serves both endpoints.
+			 */
+			bool reactor;
+			
+			/**
+			 * \brief The CPUs server threads are pinned to, or empty to leave them
+			 * unpinned.
+			 * 
+			 * The sync or reactor thread takes the first, the async thread the second,
+			 * and pool workers the rest, wrapping around when there are fewer CPUs than
+			 * threads.
+			 */
+			std::vector<unsigned int> cpus;
+			
+			/**
+			 * \brief How the output endpoint packs items into messages.
+			 */
+			coalesce_mode coalesceMode;
+			
+			/**
+			 * \brief The most items packed into a message.
+			 */
+			std::size_t coalesceItems;
+			
+			/**
+			 * \brief The data bytes at which a message is closed.
+			 * 
+			 * A multipart message is closed by the item that reaches this, and a framed
+			 * message before the item that would exceed it, so an item larger than this
+			 * is framed on its own.
+			 */
+			std::size_t coalesceBytes;
+			
+			/**
+			 * \brief The most messages of actions taken in by the pool and not yet
+			 * answered, or zero for no limit.
+			 * 
+			 * A message over the limit is answered as overloaded at once.
+			 */
+			std::size_t maxInFlight;
+			
+			/**
+			 * \brief The rate limit of each rate limited method.
+			 * 
+			 * Only written while the server is stopped, so it is read without a lock.
+			 */
+			std::vector<std::pair<std::string, std::unique_ptr<token_bucket>>> methodRates;
+			
+			/**
+			 * \brief The number of actions answered as overloaded.
+			 */
+			std::atomic<std::uint64_t> overloadedCount;
+			
+			/**
+			 * \brief Whether or not the sync endpoint is busy polled rather than waited
+			 * on.
+			 */
+			bool busyPoll;
+			
+			/**
+			 * \brief How long the endpoints may be quiet before a busy polling thread
+			 * falls back to blocking until the next message.
+			 * 
+			 * \note Microseconds.
+			 */
+			std::size_t busyPollIdle;
+			
+			/**
+			 * \brief The most CPU relax hints between spins that find nothing.
+			 * 
+			 * The hints between spins double from none up to this, so a quiet thread
+			 * spins less hard, and go back to none as soon as a spin finds something.
+			 */
+			std::size_t busyPollPause;
+			
 			/*
 			 * \brief The timeout period when waiting to receive a tx request from the
 			 * client.
 			 * 
-			 * Changing this will alter the responsiveness when stopping the server and
-			 * the idle CPU usage. The former and latter have an inverse relationship.
-			 * 
 			 * \note Milliseconds.
 			 */
 			static const int sync_send_to = 300;
@@ -64,14 +225,18 @@ namespace net {
 			 * \brief The timeout period when waiting to receive confirmation a response
 			 * was sent to a client in response to their tx request.
 			 * 
-			 * Changing this will alter the responsiveness when stopping the server and
-			 * the reliability of transmission to the client. This should be increased if
-			 * network is congested.
+			 * Changing this will alter the reliability of transmission to the client.
+			 * This should be increased if network is congested.
 			 * 
 			 * \note Milliseconds.
 			 */
 			static const int sync_receive_to = 300;
 			
+			/**
+			 * \brief The default number of worker threads in pool mode.
+			 */
+			static const int sync_pool_workers = 4;
+			
 			/**
 			 * \brief The timeout period when waiting to send a response to the client.
 			 * 
@@ -95,7 +260,7 @@ namespace net {
 			 * size, increasing the failure rate, and making the buffer flush before the
 			 * desired size is reached.
 			 * 
-			 * \note Milliseconds.
+			 * \note Milliseconds. Adaptive batching waits the target latency instead.
 			 */
 			static const int async_wait_to = 300;
 			
@@ -106,6 +271,8 @@ namespace net {
 			 * associated with locking and unlocking the queue. Making this smaller will
 			 * make the rx thread more active as it will spend less time sleeping waiting
 			 * for a condition variable.
+			 * 
+			 * With adaptive batching this is only the size the first batch waits for.
 			 */
 			static const int async_wait_count = 100;
 			
@@ -114,9 +281,52 @@ namespace net {
 			 * period for the buffer to achieve the desired size.
 			 * 
 			 * Changing this will affect the responsiveness of the rx data being pushed to
-			 * the client and the responsiveness when stopping the server.
+			 * the client. An empty buffer is not waited on, its next item is sent as soon
+			 * as it is pushed.
 			 */
 			static const int async_wait_fail = 4;
+			
+			/**
+			 * \brief The most items taken from the rx buffer at a time while emptying it.
+			 * 
+			 * Between takes, items pushed into a higher priority lane of the buffer go
+			 * ahead of what is left, so making this smaller lowers the latency of
+			 * priority items at the cost of more trips into the buffer.
+			 */
+			static const int async_drain_max = 64;
+			
+			/**
+			 * \brief The default most items packed into a message when coalescing.
+			 */
+			static const int async_coalesce_items = 64;
+			
+			/**
+			 * \brief The default data bytes at which a message is closed when
+			 * coalescing.
+			 */
+			static const int async_coalesce_bytes = 65536;
+			
+			/**
+			 * \brief The default quiet period before busy polling falls back to
+			 * blocking.
+			 * 
+			 * \note Microseconds.
+			 */
+			static const int busy_poll_idle = 100000;
+			
+			/**
+			 * \brief The default most CPU relax hints between spins that find nothing.
+			 */
+			static const int busy_poll_pause = 64;
+			
+			/**
+			 * \brief The number of spins between non-blocking polls of the exit and
+			 * push events while busy polling.
+			 * 
+			 * Every spin tries to receive on the sync socket without a system call, while
+			 * the events are file descriptors that take one to check.
+			 */
+			static const int busy_poll_events = 64;
 		 
 			/**
 			 * \brief Sync action listening function that is called in a seperate thread.
@@ -125,12 +335,201 @@ namespace net {
 			 */
 			void sync_work();
 			
+			/**
+			 * \brief Serve a single client over a PAIR socket.
+			 */
+			void sync_pair();
+			
+			/**
+			 * \brief Route the actions of every client to a pool of worker threads and
+			 * route their responses back.
+			 * 
+			 * Each action goes to a worker that is idle, and each response is sent as
+			 * soon as it is ready, so a slow action only holds up the worker it landed
+			 * on and a client with several actions in flight may be answered out of
+			 * order.
+			 * 
+			 * With a limit on the actions in flight, actions are taken from the frontend
+			 * as they arrive and held until a worker is idle, and those over the limit
+			 * are answered as overloaded from this thread.
+			 */
+			void sync_pool();
+			
+			/**
+			 * \brief Worker thread of the pool that asks for an action over the backend
+			 * endpoint, answers it, and asks again.
+			 * 
+			 * \note Threadsafe.
+			 */
+			void sync_pool_work(const std::string backendEndpoint,
+					const std::size_t slot);
+			
+			/**
+			 * \brief Answer a message received on a routing socket, whose first frames
+			 * up to an empty delimiter address the client, by sending the address back
+			 * ahead of the response.
+			 * 
+			 * The envelope is only passed in so its capacity is kept from one call to the
+			 * next.
+			 * 
+			 * \note Threadsafe.
+			 */
+			void answer_routed(::zmq::socket_t& socket,
+					::zmq::message_t& rcvMsg,
+					std::vector<::zmq::message_t>& envelope,
+					const bool shed);
+			
+			/**
+			 * \brief Process the received action, or the batch of actions if more frames
+			 * of its message follow, and send the response.
+			 * 
+			 * A frame that is not a request is answered as malformed in its place.
+			 * 
+			 * If shed is true every action is answered as overloaded instead.
+			 * 
+			 * \note Threadsafe.
+			 */
+			void answer(::zmq::socket_t& socket,
+					::zmq::message_t& rcvMsg,
+					const bool mustAnswer,
+					const bool shed);
+			
+			/**
+			 * \brief Process a received action, or a JSON array of actions, and return
+			 * the response to send.
+			 * 
+			 * The response carries the id of the request if it has one. If the action is
+			 * not one the input endpoint answers we return NULL, or an error response if
+			 * mustAnswer is true. An action that is shed or over the rate of its method
+			 * is answered as overloaded, and input that is not a request as malformed.
+			 * 
+			 * \note Threadsafe.
+			 */
+			response* process(::zmq::message_t& rcvMsg,
+					const bool mustAnswer,
+					const bool shed);
+			
+			/**
+			 * \brief Process a batch of actions under a single acquisition of the module
+			 * manager and append their responses, in order.
+			 * 
+			 * Actions that are shed or over the rate of their method are answered as
+			 * overloaded in their place, and are moved from if any others are processed.
+			 * 
+			 * \note Threadsafe.
+			 */
+			void process_batch(std::vector<request>& requests,
+					std::vector<response*>& responses,
+					const bool shed);
+			
+			/**
+			 * \brief Pass a batch of actions to the module manager, answering every one
+			 * with the error if it fails as a whole.
+			 * 
+			 * \note Threadsafe.
+			 */
+			void module_batch(const std::vector<request>& requests,
+					std::vector<response*>& responses);
+			
+			/**
+			 * \brief Return whether or not an action may be processed, counting it as
+			 * overloaded if not.
+			 * 
+			 * An action is not admitted if it is shed, or if its method is rate limited
+			 * and out of tokens.
+			 * 
+			 * \note Threadsafe.
+			 */
+			bool admit(const request& rqst, const bool shed);
+			
+			/**
+			 * \brief Send a response without copying it, taking ownership of it.
+			 */
+			static bool send_response(::zmq::socket_t& socket,
+					response* const rspns,
+					const int flags = 0);
+			
+			/**
+			 * \brief Move a whole multipart message from one socket to another.
+			 */
+			static void forward(::zmq::socket_t& from, ::zmq::socket_t& to);
+			
+			/**
+			 * \brief Return whether or not more frames of the last message received on
+			 * the socket follow.
+			 */
+			static bool has_more(::zmq::socket_t& socket);
+			
+			/**
+			 * \brief Return the data of a message to be parsed in place, or NULL if it is
+			 * JSON that is not null terminated.
+			 */
+			static char* insitu(::zmq::message_t& msg);
+			
+			/**
+			 * \brief Return whether or not JSON input is an array of actions.
+			 */
+			static bool is_batch(const char* input);
+			
 			/**
 			 * \brief Async action sending function that is called in a seperate thread.
 			 * 
 			 * \note Threadsafe.
 			 */
 			void async_work();
+			
+			/**
+			 * \brief Return whether or not a single thread serves both endpoints.
+			 */
+			bool is_reactor() const;
+			
+			/**
+			 * \brief Sync action listening and async action sending function that is
+			 * called in a seperate thread in place of both.
+			 * 
+			 * \note Threadsafe.
+			 */
+			void reactor_work();
+			
+			/**
+			 * \brief Serve the sync socket, the async socket, or both from the calling
+			 * thread until the server exits.
+			 * 
+			 * Either socket may be NULL. The thread sleeps in a single poll over the
+			 * sockets, the push event of the async buffer, and the exit event.
+			 * 
+			 * When busy polling, the thread spins on a non-blocking receive of the sync
+			 * socket instead, checking the events every so often, until the sockets have
+			 * been quiet for the idle period. It then sleeps in the poll as usual until
+			 * the next message or item.
+			 */
+			void react(::zmq::socket_t* const syncSocket,
+					::zmq::socket_t* const asyncSocket);
+			
+			/**
+			 * \brief Empty the async buffer onto the async socket, coalescing items as
+			 * configured, and adjust the batch to the drain.
+			 * 
+			 * The local buffer and frame are only passed in so their capacity is kept
+			 * from one call to the next.
+			 */
+			void send_async(::zmq::socket_t& socket,
+					::buffer::queue_buffer& asyncBuffer,
+					batch_control& batching,
+					std::vector<::buffer::buffer_item>& localBuffer,
+					std::string& frame);
+			
+			/**
+			 * \brief Return a message that takes over the data of an item without
+			 * copying it.
+			 */
+			static ::zmq::message_t item_message(::buffer::buffer_item& item);
+			
+			/**
+			 * \brief Pin the calling thread to the CPU for a thread slot, if CPUs were
+			 * configured.
+			 */
+			void pin_thread(const std::size_t slot);
 		};
 	}
 }